@@ -323,9 +323,13 @@ for lib in \
 done
 wait
 
+# the prelinked objects of each library (before liball_llvm_clang_lld.o,
+# which is made from them, is added to $PRELINK_DIR)
+LIB_OBJS=( "$PRELINK_DIR"/*.o )
+
 # create one unified lib out of all libs, for derivative clang & lld (e.g. "myclang")
 if $LLVMBOX_ENABLE_LTO; then
-  _create_prelinked_obj "$PRELINK_DIR/liball_llvm_clang_lld.o" "$PRELINK_DIR"/*.o
+  _create_prelinked_obj "$PRELINK_DIR/liball_llvm_clang_lld.o" "${LIB_OBJS[@]}"
   _create_archive       "$DESTDIR/lib/liball_llvm_clang_lld.a" \
                         "$PRELINK_DIR/liball_llvm_clang_lld.o"
   _optimize_mc_archive  "$DESTDIR/lib/liball_llvm_clang_lld.a"
@@ -333,6 +337,33 @@ else
   echo "WARNING! liball_llvm_clang_lld.a not implemented for LLVMBOX_ENABLE_LTO=0" >&2
 fi
 
+# create a prelinked object of just the clang & lld driver stack, for fast
+# relinking of derivative drivers (myclang/build.sh uses it when present.)
+# The undefined symbols of the upstream clang & lld tool objects are the API
+# surface of the driver stack; they are the roots for --gc-sections, which
+# drops everything not reachable from them (and resolves all archive members
+# up front, so that linking needs no archive symbol resolution.)
+_create_driver_obj_linux() { # <outfile> <infile> ...
+  local outfile="$1" ; shift
+  local tooldir="$BUILD_DIR/llvm-stage2/tools"
+  local roots=() sym
+  while read -r sym; do
+    roots+=( -u "$sym" )
+  done < <("$LLVM_STAGE1/bin/llvm-nm" --undefined-only --format=just-symbols \
+             "$tooldir"/clang/tools/driver/CMakeFiles/clang.dir/*.o \
+             "$tooldir"/lld/tools/lld/CMakeFiles/lld.dir/*.o \
+           | sort -u)
+  [ ${#roots[@]} -gt 0 ] || _err "no driver objects found in $(_relpath "$tooldir")"
+  _create_prelinked_obj_linux "$outfile" --gc-sections "${roots[@]}" "$@"
+}
+if $LLVMBOX_ENABLE_LTO && [ "$TARGET_SYS" = linux ]; then
+  _create_driver_obj_linux "$DESTDIR/lib/llvm_clang_lld_driver.o" "${LIB_OBJS[@]}"
+  _optimize_mc_archive     "$DESTDIR/lib/llvm_clang_lld_driver.o"
+else
+  echo "WARNING! llvm_clang_lld_driver.o not implemented for $TARGET_SYS" \
+       "LLVMBOX_ENABLE_LTO=$LLVMBOX_ENABLE_LTO" >&2
+fi
+
 # create symlink for development
 if [ "$(dirname "$DESTDIR")" = "$OUT_DIR" ]; then
   _symlink "$OUT_DIR/llvmbox-dev" "$(basename "$DESTDIR")"
@@ -83,38 +83,18 @@ install -v -m755 "$PROJECT/llvmbox-tools/llvmbox-mksysroot" "$DESTDIR/bin"
 install -v -m755 "$PROJECT/llvmbox-tools/llvmbox-dedup-target-files" "$DESTDIR/bin"
 
 # ————————————————————————————————————————————————————————————————————————————————————
-# generate bin/clang-TARGET wrappers
+# create bin/clang-TARGET launchers
+# These are symlinks to llvmbox-clang, which derives the target from its name
+# and computes flags at runtime (see llvmbox-tools/llvmbox-clang.c)
+install -v -m755 "$PROJECT/llvmbox-tools/llvmbox-clang" "$DESTDIR/bin"
 EXTRA_DIST_TARGETS_U=()
 EXTRA_DIST_TARGETS=()
 
-_gen_clang_wrapper() { # <target>
-  local target=$1 arch sys sysver target2 found triple
-  local CFLAGS LDFLAGS USER_START= USER_END=
+_gen_clang_launcher() { # <target>
+  local target=$1 arch sys sysver target2 found
   IFS=- read -r arch sys <<< "$target"
   IFS=. read -r sys sysver <<< "$sys"
-  triple=$(_fmt_triple $arch $sys $sysver)
-
-  CFLAGS=( -fPIC )
-  LDFLAGS=()
-
-  # including TargetConditionals.h prevents "error: TARGET_OS_EMBEDDED is not defined"
-  [ "$sys" = macos ] && CFLAGS+=(
-    -Wno-nullability-completeness \
-    -include TargetConditionals.h \
-  )
-
-  [ -d "$DESTDIR/targets/$arch-$sys.$sysver/include" ] &&
-    CFLAGS+=( "-I\$LLVMBOX/targets/$arch-$sys.$sysver/include" )
-  [ -d "$DESTDIR/targets/$arch-$sys/include" ] &&
-    CFLAGS+=( "-I\$LLVMBOX/targets/$arch-$sys/include" )
-  [ -d "$DESTDIR/targets/any-$sys/include" ] &&
-    CFLAGS+=( "-I\$LLVMBOX/targets/any-$sys/include" )
-
   if [ -n "$sysver" ]; then
-    [ -d "$DESTDIR/targets/any-$sys.$sysver/lib" ] &&
-      LDFLAGS+=( "-L\$LLVMBOX/targets/any-$sys.$sysver/lib" )
-    [ -d "$DESTDIR/targets/$arch-$sys/lib" ] &&
-      LDFLAGS+=( "-L\$LLVMBOX/targets/$arch-$sys/lib" )
     found=
     for target2 in "${EXTRA_DIST_TARGETS_U[@]:-}"; do
       if [ "$target2" = "$arch-$sys" ]; then found=1; break; fi
@@ -124,38 +104,15 @@ _gen_clang_wrapper() { # <target>
       EXTRA_DIST_TARGETS+=( "$target" )
     fi
   fi
-
-  [ -d "$DESTDIR/targets/any-$sys/lib" ] &&
-    LDFLAGS+=( "-L\$LLVMBOX/targets/any-$sys/lib" )
-
-  LDFLAGS+=( -lc -lrt -fPIE )
-
-  if [ $sys = linux ]; then
-    LDFLAGS+=( -nostartfiles -static \$LIB/crt1.o )
-    USER_START=-L-user-start
-    USER_END=-L-user-end
-  fi
-
-  echo "generate $(_relpath "$DESTDIR/bin/clang-$target")"
-  sed -e "s!@LLVMBOXID@!$LLVMBOXID!g" \
-      -e "s!@ARCH@!$arch!g" \
-      -e "s!@SYS@!$sys!g" \
-      -e "s!@TARGETID@!$target!g" \
-      -e "s!@TRIPLE@!$triple!g" \
-      -e "s!@CFLAGS@!${CFLAGS[*]}!g" \
-      -e "s!@LDFLAGS@!${LDFLAGS[*]}!g" \
-      -e "s!@USER_START@!$USER_START!g" \
-      -e "s!@USER_END@!$USER_END!g" \
-      "$PROJECT/utils/clang-TARGET.in" > "$DESTDIR/bin/clang-$target"
-  chmod 0755 "$DESTDIR/bin/clang-$target"
-  _symlink "$DESTDIR/bin/clang++-$target" "clang-$target"
+  _symlink "$DESTDIR/bin/clang-$target" llvmbox-clang
+  _symlink "$DESTDIR/bin/clang++-$target" llvmbox-clang
 }
 
 IFS=$'\n' SUPPORTED_DIST_TARGETS=(
   $(sort -u -V <<< "${SUPPORTED_DIST_TARGETS[*]}") ); unset IFS
 for target in ${SUPPORTED_DIST_TARGETS[@]}; do
   case "$target" in wasm*) continue ;; esac # wasm targets not yet supported
-  _gen_clang_wrapper $target
+  _gen_clang_launcher $target
 done
 
 for target in "${EXTRA_DIST_TARGETS[@]}"; do
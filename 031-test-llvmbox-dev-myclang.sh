@@ -9,3 +9,22 @@ set -x
 bash myclang/build.sh "${LLVM_ROOT:-$OUT_DIR/llvmbox}" "$@"
 myclang/myclang cc $FLAGS test/hello.c -o out/hello
 out/hello
+
+# assembler batch mode: assemble musl's .s files in one process ("as -batch")
+# and with one process per file, check that the objects are identical and
+# print the time of each
+if [ "$TARGET_SYS" = linux ]; then
+  ASM_DIR=out/test-myclang-as-batch
+  rm -rf "$ASM_DIR"
+  mkdir -p "$ASM_DIR"/{batch,single}
+  for f in sysroots/libc/musl/src/*/$TARGET_ARCH/*.s; do
+    o=$(echo "${f#sysroots/libc/musl/src/}" | tr / _).o
+    echo "$f $o -triple $TARGET_ARCH-unknown-linux-musl -filetype obj"
+  done > "$ASM_DIR/jobs"
+  sed "s| | $ASM_DIR/batch/|" "$ASM_DIR/jobs" > "$ASM_DIR/jobs-batch"
+  time myclang/myclang as -batch "$ASM_DIR/jobs-batch"
+  time while read -r f o flags; do
+    myclang/myclang as $flags -o "$ASM_DIR/single/$o" "$f"
+  done < "$ASM_DIR/jobs"
+  diff -r "$ASM_DIR/batch" "$ASM_DIR/single"
+fi
@@ -376,6 +376,49 @@ _sha_test() { # <file> [<sha256> | <sha512>]
   [ "$actual" = "$expect" ] || return 1
 }
 
+# _objcache_hdrhash prints a hash of the headers (*.h and *.inc files) in
+# <dir>s, for _objcache_key. Header changes which are not reflected in the
+# llvmbox version, like those to musl's internal headers, thus change the keys
+# of all objects compiled with them.
+_objcache_hdrhash() { # <dir> ...
+  local d
+  for d in "$@"; do
+    [ -d "$d" ] || continue
+    echo "${d##*/}"
+    ( cd "$d" &&
+      find . \( -type f -o -type l \) \( -name '*.h' -o -name '*.inc' \) -print0 |
+      LC_ALL=C sort -z | xargs -0 sha256sum )
+  done | sha256sum | cut -c1-32
+}
+
+# _objcache_key prints the key under which the object compiled from <srcfile>
+# with <flag>s is stored in the runtime build files' object cache ($objcache).
+# <hdrhash> is the _objcache_hdrhash of the include directories.
+_objcache_key() { # <srcfile> <hdrhash> <flag> ...
+  local src=$1 ; shift
+  { echo "$*"; cat "$src"; } | sha256sum | cut -c1-32
+}
+
+# _objcache_dir prints the value of $objcache: a directory in the user's cache
+# directory, expanded by the shell running the "cc" rule
+_objcache_dir() {
+  echo "\$\${XDG_CACHE_HOME:-\$\$HOME/.cache}/llvmbox/objcache-$LLVM_RELEASE+$LLVMBOX_VERSION_TAG"
+}
+
+# _objcache_cc_command prints the command of a ninja "cc" rule which compiles
+# $in to $out, reusing the object at $objcache/$key.o when it exists and
+# otherwise adding the object to $objcache once compiled. Failing to add it
+# (e.g. if the cache directory is not writable) doesn't fail the build.
+# A cache hit writes a depfile without dependencies.
+_objcache_cc_command() {
+  echo 'if cp "$objcache/$key.o" $out 2>/dev/null; then echo "$out:" > $out.d;' \
+       'else ../../bin/clang -MMD -MF $out.d $cflags $flags -c -o $out $in' \
+       '&& { mkdir -p "$objcache"' \
+       '&& cp $out "$objcache/$key.o.$$$$"' \
+       '&& mv -f "$objcache/$key.o.$$$$" "$objcache/$key.o"' \
+       '|| rm -f "$objcache/$key.o.$$$$"; true; } 2>/dev/null; fi'
+}
+
 _sha_verify() { # <file> [<sha256> | <sha512>]
   local file=$1
   local expect=$2
@@ -0,0 +1,1046 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// clang-TARGET launcher.
+// Installed as bin/llvmbox-clang with bin/clang-TARGET and bin/clang++-TARGET
+// symlinks to it. When linking, builds the runtime libraries of TARGET which the
+// link needs and which are missing, then execs bin/clang (or bin/clang++) with
+// the flags for TARGET.
+// Unless a library needs to be built, no other process is spawned.
+//
+// When linking with -flto (or -flto=thin), libc and libc++ are built as ThinLTO
+// bitcode into targets/TARGET/lib-lto so that programs can be LTO'd through them.
+// Similarly, -march=TIER or -mcpu=TIER (e.g. x86-64-v3, armv8.2-a, neoverse-n1)
+// selects runtime libraries tuned for that CPU, in targets/TARGET/lib-TIER
+// (lib-TIER-lto when combined with -flto.)
+//
+// On linux, -lmalloc-fast links the scalable malloc of src/musl/src/malloc/fast
+// ahead of libc.a, replacing musl's malloc.
+//
+#include "llvmboxlib.h"
+#include <ctype.h>
+#include <stdarg.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+
+#define STR1(x) #x
+#define STR(x) STR1(x)
+#define LLVMBOXID "llvmbox-" STR(LLVM_VERSION) "+" STR(LLVMBOX_VERSION)
+
+
+static char llvmbox_dir[PATH_MAX];
+static char lib_dir[PATH_MAX]; // llvmbox/targets/TARGET/lib[-VARIANT]
+static char targetid[64];      // e.g. "x86_64-macos.10"
+static char variant[64];       // e.g. "lto", or "" for the regular libraries
+static bool variant_lto;
+static const char* variant_cpu; // e.g. "-march=x86-64-v3"
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// GNU make jobserver
+//
+// When clang-TARGET is run by "make -jN", MAKEFLAGS holds --jobserver-auth=R,W
+// (a pipe; make < 4.4) or --jobserver-auth=fifo:PATH. Instead of running ninja
+// with one job per CPU in each of make's N jobs, we take as many of the
+// jobserver's free tokens as we can without waiting (up to CPUs-1) and run
+// ninja with that many jobs plus the one make started us with. The tokens are
+// returned when ninja exits.
+// Note: the background build of the complete libc.a outlives the make job
+// which started it, so it detaches from the jobserver (jobserver_detach) and
+// runs one job without a token.
+
+static int jobserver_rfd = -2; // non-blocking read end; -1 if there's no jobserver
+static int jobserver_wfd = -1;
+
+
+// is_fifo returns true if fd is a pipe or FIFO, storing its status in st
+static bool is_fifo(int fd, struct stat* st) {
+  return fstat(fd, st) == 0 && S_ISFIFO(st->st_mode);
+}
+
+
+static bool jobserver_open(void) {
+  if (jobserver_rfd != -2)
+    return jobserver_rfd > -1;
+  jobserver_rfd = -1;
+  const char* makeflags = getenv("MAKEFLAGS");
+  if (!makeflags)
+    return false;
+  // the last option wins; --jobserver-fds is what make < 4.2 calls it
+  const char* auth = NULL, *p;
+  for (p = makeflags; (p = strstr(p, "--jobserver-")); p++) {
+    if (strncmp(p, "--jobserver-auth=", 17) == 0) {
+      auth = p + 17;
+    } else if (strncmp(p, "--jobserver-fds=", 16) == 0) {
+      auth = p + 16;
+    }
+  }
+  if (!auth)
+    return false;
+
+  if (strncmp(auth, "fifo:", 5) == 0) {
+    char path[PATH_MAX];
+    usize len = strcspn(auth + 5, " ");
+    if (len >= sizeof(path))
+      return false;
+    memcpy(path, auth + 5, len);
+    path[len] = 0;
+    struct stat st;
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd > -1 && !is_fifo(fd, &st)) {
+      close(fd);
+      fd = -1;
+    }
+    jobserver_rfd = fd;
+    jobserver_wfd = fd;
+  } else {
+    // Make only passes the pipe to commands it knows are makes ("+" rules)
+    // but leaves MAKEFLAGS as is, so R and W may be closed or be unrelated
+    // files which happen to be open; both must be the ends of the same pipe.
+    // The read end is reopened so that we can make it non-blocking without
+    // affecting other processes.
+    int rfd, wfd;
+    struct stat rst, wst;
+    if (sscanf(auth, "%d,%d", &rfd, &wfd) != 2 ||
+        !is_fifo(rfd, &rst) || !is_fifo(wfd, &wst))
+    {
+      return false;
+    }
+    #ifdef __linux__
+      // the two ends of a pipe are the same inode
+      if (rst.st_dev != wst.st_dev || rst.st_ino != wst.st_ino)
+        return false;
+      char path[32];
+      snprintf(path, sizeof(path), "/proc/self/fd/%d", rfd);
+      jobserver_rfd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    #endif
+    jobserver_wfd = wfd;
+  }
+  return jobserver_rfd > -1;
+}
+
+
+// jobserver_acquire takes up to cap free tokens from the jobserver.
+// Returns the number of tokens taken, which are stored in tokens.
+static int jobserver_acquire(char* tokens, int cap) {
+  if (cap < 1 || !jobserver_open())
+    return 0;
+  isize n;
+  while ((n = read(jobserver_rfd, tokens, (usize)cap)) < 0 && errno == EINTR) {}
+  return n > 0 ? (int)n : 0;
+}
+
+
+static void jobserver_release(const char* tokens, int ntokens) {
+  while (ntokens > 0) {
+    isize n = write(jobserver_wfd, tokens, (usize)ntokens);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      warn("jobserver");
+      return;
+    }
+    tokens += n;
+    ntokens -= (int)n;
+  }
+}
+
+
+// jobserver_detach closes our jobserver descriptors and stops us (and ninja)
+// from using the jobserver
+static void jobserver_detach(void) {
+  if (jobserver_rfd > -1)
+    close(jobserver_rfd);
+  if (jobserver_wfd > -1 && jobserver_wfd != jobserver_rfd)
+    close(jobserver_wfd);
+  jobserver_rfd = -1;
+  jobserver_wfd = -1;
+  unsetenv("MAKEFLAGS");
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+
+// ninja runs "ninja -f <buildfile> [<target>]" in llvmbox/src/<srcdir>.
+// Returns ninja's exit status (128+N if killed by signal N.)
+static int ninja(const char* srcdir, const char* buildfile, const char* target) {
+  char dir[PATH_MAX], ninja[PATH_MAX], jobs[32], tokens[256];
+  snprintf(dir, sizeof(dir), "%s/src/%s", llvmbox_dir, srcdir);
+  snprintf(ninja, sizeof(ninja), "%s/bin/ninja", llvmbox_dir);
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  int ntokens = 0;
+  if (jobserver_open()) {
+    ntokens = jobserver_acquire(tokens, (int)MIN_X(ncpu - 1, (long)sizeof(tokens)));
+    ncpu = 1 + ntokens;
+  }
+  snprintf(jobs, sizeof(jobs), "-j%ld", ncpu);
+
+  pid_t pid = fork();
+  if (pid < 0)
+    err(1, "fork");
+  if (pid == 0) {
+    int devnull = open("/dev/null", O_WRONLY);
+    if (devnull > -1)
+      dup2(devnull, STDOUT_FILENO);
+    if (chdir(dir) != 0) {
+      warn("chdir %s", dir);
+      _exit(127);
+    }
+    execl(ninja, "ninja", "-f", buildfile, jobs, target, (char*)NULL);
+    warn("exec %s", ninja);
+    _exit(127);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      err(1, "waitpid");
+  }
+  jobserver_release(tokens, ntokens);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+
+// rm_objdir removes ninja's object directory /tmp/LLVMBOXID-<objname>[-VARIANT]
+static void rm_objdir(const char* objname) {
+  char objdir[PATH_MAX];
+  snprintf(objdir, sizeof(objdir), "/tmp/" LLVMBOXID "-%s%s%s",
+    objname, *variant ? "-" : "", variant);
+  if (isdir(objdir))
+    rmfile_recursive(objdir);
+}
+
+
+// build builds lib_dir/<libname> with ninja (target NULL builds the defaults)
+static void build(
+  const char* libname, const char* srcdir, const char* buildfile, const char* objname,
+  const char* target)
+{
+  fprintf(stderr, "building %s/%s...\n", lib_dir, libname);
+  if (ninja(srcdir, buildfile, target) != 0)
+    errx(1, "failed to build %s/%s", lib_dir, libname);
+  rm_objdir(objname);
+}
+
+
+static bool lib_exists(const char* libname) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", lib_dir, libname);
+  struct stat st;
+  return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// runtime variants
+//
+// Libraries built with extra compiler flags live in targets/TARGET/lib-VARIANT.
+// Their build files are derived from the regular ones (src/SRCDIR/build-*.ninja)
+// by adding the flags to cflags and suffixing libdir, obj and objcache with
+// -VARIANT. They are written to lib_dir/.SRCDIR-build-*.ninja.
+//
+// TIER: all libraries are compiled with -march=TIER or -mcpu=TIER.
+// lto: libc and libc++ are ThinLTO bitcode. compiler-rt builtins and crt objects
+// remain machine code: calls to builtins are generated during LTO code
+// generation, after the linker has resolved symbols.
+
+static bool has_prefix(const char* p, usize len, const char* prefix) {
+  usize n = strlen(prefix);
+  return len >= n && memcmp(p, prefix, n) == 0;
+}
+
+
+// variant_cflags returns the flags added to cflags of srcdir's build file
+static void variant_cflags(char* buf, usize bufcap, const char* srcdir) {
+  bool lto = variant_lto && strcmp(srcdir, "builtins") != 0;
+  snprintf(buf, bufcap, "%s%s%s",
+    variant_cpu ? " " : "", variant_cpu ? variant_cpu : "", lto ? " -flto=thin" : "");
+}
+
+
+// cpu_tier returns the TIER of flag "-march=TIER" or "-mcpu=TIER", or NULL if
+// TIER is not suitable as a directory name or, like "native", is not portable.
+static const char* cpu_tier(const char* flag) {
+  const char* tier = strchr(flag, '=') + 1;
+  usize len = strlen(tier);
+  if (len == 0 || len > 32 || strcmp(tier, "native") == 0)
+    return NULL;
+  for (usize i = 0; i < len; i++) {
+    char c = tier[i];
+    if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.' && c != '+')
+      return NULL;
+  }
+  return tier;
+}
+
+
+// variant_buildfile writes the variant of build file src to dst
+static bool variant_buildfile(const char* src, const char* dst, const char* srcdir) {
+  char tmp[PATH_MAX], cflags[128];
+  slice_t data;
+  if (!load_file(src, &data)) {
+    warn("%s", src);
+    return false;
+  }
+  snprintf(tmp, sizeof(tmp), "%s.%d.tmp", dst, (int)getpid());
+  FILE* f = fopen(tmp, "w");
+  if (!f) {
+    warn("%s", tmp);
+    unload_file(&data);
+    return false;
+  }
+  variant_cflags(cflags, sizeof(cflags), srcdir);
+
+  const char* p = data.cstr, *end = data.cstr + data.len;
+  while (p < end) {
+    const char* nl = memchr(p, '\n', (usize)(end - p));
+    usize len = nl ? (usize)(nl - p) : (usize)(end - p);
+    fwrite(p, 1, len, f);
+    if (has_prefix(p, len, "cflags = ")) {
+      fputs(cflags, f);
+    } else if (has_prefix(p, len, "libdir = ") || has_prefix(p, len, "obj = ") ||
+               (*cflags && has_prefix(p, len, "objcache = ")))
+    {
+      fprintf(f, "-%s", variant);
+    } else if (variant_lto && has_prefix(p, len, "  flags = -DCRT")) {
+      fputs(" -fno-lto", f);
+    }
+    if (nl)
+      fputc('\n', f);
+    p += len + 1;
+  }
+  unload_file(&data);
+
+  if (fclose(f) != 0 || rename(tmp, dst) != 0) {
+    warn("%s", dst);
+    unlink(tmp);
+    return false;
+  }
+  return true;
+}
+
+
+// buildfile_path sets path to that of srcdir's build file <name>, or to that of
+// its variant (which is created)
+static void buildfile_path(char path[PATH_MAX], const char* srcdir, const char* name) {
+  snprintf(path, PATH_MAX, "%s/src/%s/%s", llvmbox_dir, srcdir, name);
+  if (!*variant)
+    return;
+  char vpath[PATH_MAX];
+  snprintf(vpath, sizeof(vpath), "%s/.%s-%s", lib_dir, srcdir, name);
+  if (!mkdirs(lib_dir, 0755))
+    err(1, "mkdirs %s", lib_dir);
+  if (!variant_buildfile(path, vpath, srcdir))
+    exit(1);
+  memcpy(path, vpath, PATH_MAX);
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// artifact store
+//
+// If LLVMBOX_ARTIFACT_STORE is set to a directory (e.g. one shared by CI workers
+// over NFS), libraries are fetched from it instead of being built, and published
+// to it after being built. Artifacts are content addressed:
+//   STORE/LLVMBOXID/TARGET/[lib-VARIANT/]LIBNAME-HASH/
+// where HASH is the SHA-256 of LLVMBOXID, TARGET, VARIANT, LIBNAME and the ninja
+// build file, which holds the flags and source list. An artifact directory holds the
+// files in lib_dir which the ninja target that builds the library produces: the
+// "default" targets, or the inputs of a phony target like "malloc-fast".
+
+typedef struct {
+  char  dir[PATH_MAX]; // STORE/LLVMBOXID/TARGET/[lib-VARIANT/]LIBNAME-HASH
+  char* outputs[64];   // files in lib_dir produced by the build
+  int   noutputs;
+} artifact_t;
+
+
+// artifact_init returns false if there's no artifact store.
+// target is the ninja target which builds libname, or NULL for the default targets.
+static bool artifact_init(
+  artifact_t* a, const char* libname, const char* buildfile, const char* target)
+{
+  const char* store = getenv("LLVMBOX_ARTIFACT_STORE");
+  if (!store || !*store)
+    return false;
+
+  slice_t data;
+  if (!load_file(buildfile, &data)) {
+    warn("%s", buildfile);
+    return false;
+  }
+
+  sha256_t state;
+  sha256sum_t sum;
+  sha256_init(&state, sum.data);
+  const char* key[] = { LLVMBOXID, targetid, variant, libname };
+  for (usize i = 0; i < countof(key); i++)
+    sha256_write(&state, key[i], strlen(key[i]) + 1);
+  sha256_write(&state, data.p, data.len);
+  sha256_close(&state);
+  char hash[SHA256_SUM_SIZE*2 + 1];
+  for (usize i = 0; i < SHA256_SUM_SIZE; i++)
+    snprintf(&hash[i*2], 3, "%02x", sum.data[i]);
+  char subdir[sizeof(variant) + 5] = "";
+  if (*variant)
+    snprintf(subdir, sizeof(subdir), "lib-%s/", variant);
+  snprintf(a->dir, sizeof(a->dir), "%s/" LLVMBOXID "/%s/%s%s-%s",
+    store, targetid, subdir, libname, hash);
+
+  // outputs: "default $libdir/a $libdir/b ..." or
+  // "build target: phony $libdir/a $libdir/b ...", with libname last
+  char line[128] = "default ";
+  if (target)
+    snprintf(line, sizeof(line), "build %s: phony ", target);
+  usize linelen = strlen(line);
+  a->noutputs = 0;
+  const char* p = data.cstr, *end = data.cstr + data.len;
+  while (p < end && !((usize)(end - p) > linelen && memcmp(p, line, linelen) == 0 &&
+                      (p == data.cstr || p[-1] == '\n')))
+  {
+    p++;
+  }
+  p += MIN_X((isize)linelen, end - p);
+  while (p < end && *p != '\n') {
+    const char* start = p;
+    while (p < end && *p != ' ' && *p != '\n')
+      p++;
+    if (p - start > 8 && memcmp(start, "$libdir/", 8) == 0 &&
+        a->noutputs < (int)countof(a->outputs) - 1)
+    {
+      char* name = strndup(start + 8, (usize)(p - start - 8));
+      if (name && strcmp(name, libname) != 0)
+        a->outputs[a->noutputs++] = name;
+    }
+    if (p < end && *p == ' ')
+      p++;
+  }
+  a->outputs[a->noutputs++] = strdup(libname);
+  unload_file(&data);
+  return true;
+}
+
+
+// artifact_fetch copies an artifact's files from the store into lib_dir.
+// Each file is copied to a temporary file and then renamed, libname last.
+static bool artifact_fetch(artifact_t* a) {
+  char src[PATH_MAX], dst[PATH_MAX], tmp[PATH_MAX];
+  if (!isdir(a->dir))
+    return false;
+  for (int i = 0; i < a->noutputs; i++) {
+    snprintf(src, sizeof(src), "%s/%s", a->dir, a->outputs[i]);
+    snprintf(dst, sizeof(dst), "%s/%s", lib_dir, a->outputs[i]);
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", dst, (int)getpid());
+    if (!copy_merge(src, tmp, COPY_MERGE_OVERWRITE) || rename(tmp, dst) != 0) {
+      warn("fetch %s", src);
+      unlink(tmp);
+      return false;
+    }
+  }
+  fprintf(stderr, "fetched %s/%s from %s\n", lib_dir, a->outputs[a->noutputs - 1], a->dir);
+  return true;
+}
+
+
+// artifact_publish copies lib_dir files to the store. A complete artifact is
+// first assembled in a temporary directory which is then renamed into place,
+// so concurrent publishers and fetchers never see partial artifacts.
+static void artifact_publish(artifact_t* a) {
+  char src[PATH_MAX], dst[PATH_MAX], tmpdir[PATH_MAX];
+  snprintf(tmpdir, sizeof(tmpdir), "%s.%d.tmp", a->dir, (int)getpid());
+  if (!mkdirs(tmpdir, 0755)) {
+    warn("mkdirs %s", tmpdir);
+    return;
+  }
+  for (int i = 0; i < a->noutputs; i++) {
+    snprintf(src, sizeof(src), "%s/%s", lib_dir, a->outputs[i]);
+    snprintf(dst, sizeof(dst), "%s/%s", tmpdir, a->outputs[i]);
+    if (!copy_merge(src, dst, 0))
+      goto error;
+  }
+  if (rename(tmpdir, a->dir) != 0 && errno != EEXIST && errno != ENOTEMPTY)
+    goto error;
+  rmfile_recursive(tmpdir); // no-op if renamed
+  return;
+error:
+  warn("publish %s", a->dir);
+  rmfile_recursive(tmpdir);
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+
+// open_lockfile opens lib_dir/.<name>.lock
+static int open_lockfile(char lockfile[PATH_MAX], const char* name) {
+  snprintf(lockfile, PATH_MAX, "%s/.%s.lock", lib_dir, name);
+  if (!mkdirs(lib_dir, 0755))
+    err(1, "mkdirs %s", lib_dir);
+  int fd = open(lockfile, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    err(1, "%s", lockfile);
+  return fd;
+}
+
+
+static void lock(int fd, const char* lockfile) {
+  while (flock(fd, LOCK_EX) != 0) {
+    if (errno != EINTR)
+      err(1, "flock %s", lockfile);
+  }
+}
+
+
+// ensure_lib builds lib_dir/<libname> if it does not exist, or fetches it from
+// the artifact store.
+// Each library of each target has its own lock (lib_dir/.<libname>.lock) so
+// that different libraries and targets can be built concurrently. Processes
+// needing a library which is being built block on the lock and wake up as
+// soon as the build is done. The build files publish archives atomically
+// (rename) and last, so a library that exists is complete.
+static void ensure_lib(
+  const char* libname, const char* srcdir, const char* buildfile_name, const char* objname,
+  const char* target)
+{
+  if (lib_exists(libname))
+    return;
+  char lockfile[PATH_MAX];
+  int fd = open_lockfile(lockfile, libname);
+  lock(fd, lockfile);
+  // another process may have built it while we were waiting for the lock
+  if (!lib_exists(libname)) {
+    char buildfile[PATH_MAX];
+    buildfile_path(buildfile, srcdir, buildfile_name);
+    artifact_t a;
+    bool has_store = artifact_init(&a, libname, buildfile, target);
+    if (!has_store || !artifact_fetch(&a)) {
+      build(libname, srcdir, buildfile, objname, target);
+      if (has_store)
+        artifact_publish(&a);
+    }
+  }
+  close(fd); // releases the lock (so does exit, e.g. if the build fails)
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// two-phase libc build
+//
+// Building all of musl takes a while, so when libc.a is missing we first build
+// a "hot core" of it (ninja target libc-core: crt, internal, stdio, string,
+// malloc, thread etc.) into lib_dir/libc-core/libc.a, which is enough to link
+// most programs. The complete libc.a is then built in a background process
+// which publishes it atomically and removes libc-core when done.
+// While only the core is available, links which fail are retried with the
+// complete libc.a once it is available (see link_with_libc_core.)
+// Two locks are used: .libc.a.lock is held while building the core (or
+// fetching the complete libc.a from the artifact store) and .libc-tail.lock
+// is held by the background process building the complete libc.a.
+// If the background build fails it writes .libc-tail.failed, and the complete
+// libc.a is not built again until the build file is newer than that file.
+
+static char libc_core_dir[PATH_MAX]; // lib_dir/libc-core
+
+
+static bool libc_core_exists(void) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/libc.a", libc_core_dir);
+  struct stat st;
+  return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+
+// close_fds closes all file descriptors except stdin, stdout, stderr and keepfd
+static void close_fds(int keepfd) {
+  #ifdef __linux__
+    DIR* d = opendir("/proc/self/fd");
+    if (d) {
+      struct dirent* e;
+      while ((e = readdir(d))) {
+        int fd = atoi(e->d_name);
+        if (fd > STDERR_FILENO && fd != keepfd && fd != dirfd(d))
+          close(fd);
+      }
+      closedir(d);
+      return;
+    }
+  #endif
+  long maxfd = sysconf(_SC_OPEN_MAX);
+  if (maxfd < 0 || maxfd > 65536)
+    maxfd = 65536;
+  for (int fd = STDERR_FILENO + 1; fd < (int)maxfd; fd++) {
+    if (fd != keepfd)
+      close(fd);
+  }
+}
+
+
+// libc_tail_background builds the complete libc.a in a background process,
+// which inherits the caller's lock on .libc-tail.lock (lockfd.)
+// The builder keeps no other file of the caller open, so that it doesn't hold
+// up whatever waits for them to close, like a pipe reading our stdout.
+static void libc_tail_background(const char* buildfile, const char* objname, int lockfd) {
+  pid_t pid = fork();
+  if (pid < 0)
+    err(1, "fork");
+  if (pid > 0) {
+    waitpid(pid, NULL, 0);
+    return;
+  }
+  // double fork so that the builder is not a child of clang
+  if (fork() != 0)
+    _exit(0);
+  setsid();
+  int devnull = open("/dev/null", O_RDWR);
+  if (devnull > -1) {
+    dup2(devnull, STDIN_FILENO);
+    dup2(devnull, STDOUT_FILENO);
+    dup2(devnull, STDERR_FILENO);
+  }
+  jobserver_detach();
+  close_fds(lockfd);
+  char failfile[PATH_MAX];
+  snprintf(failfile, sizeof(failfile), "%s/.libc-tail.failed", lib_dir);
+  int status = ninja("musl", buildfile, NULL);
+  if (status != 0) {
+    FILE* f = fopen(failfile, "w");
+    if (f) {
+      fprintf(f, "ninja -f %s exited with status %d\n", buildfile, status);
+      fclose(f);
+    }
+    _exit(1);
+  }
+  unlink(failfile);
+  artifact_t a;
+  if (artifact_init(&a, "libc.a", buildfile, NULL))
+    artifact_publish(&a);
+  rmfile_recursive(libc_core_dir);
+  rm_objdir(objname);
+  _exit(0);
+}
+
+
+// libc_tail_failed returns true if the background build of the complete libc.a
+// failed and buildfile hasn't changed since
+static bool libc_tail_failed(const char* buildfile) {
+  char failfile[PATH_MAX];
+  snprintf(failfile, sizeof(failfile), "%s/.libc-tail.failed", lib_dir);
+  struct stat st, bst;
+  if (stat(failfile, &st) != 0)
+    return false;
+  if (stat(buildfile, &bst) == 0 && bst.st_mtime > st.st_mtime) {
+    unlink(failfile);
+    return false;
+  }
+  return true;
+}
+
+
+// ensure_libc makes sure libc is available.
+// Returns true if only the core is available (libc_core_dir)
+static bool ensure_libc(const char* arch) {
+  char buildfile_name[128], buildfile[PATH_MAX], objname[128], lockfile[PATH_MAX];
+  snprintf(buildfile_name, sizeof(buildfile_name), "build-%s.ninja", arch);
+  snprintf(objname, sizeof(objname), "musl-%s", arch);
+  snprintf(libc_core_dir, sizeof(libc_core_dir), "%s/libc-core", lib_dir);
+
+  if (lib_exists("libc.a"))
+    return false;
+  buildfile_path(buildfile, "musl", buildfile_name);
+
+  if (!libc_core_exists()) {
+    int fd = open_lockfile(lockfile, "libc.a");
+    lock(fd, lockfile);
+    if (lib_exists("libc.a")) {
+      close(fd);
+      return false;
+    }
+    if (!libc_core_exists()) {
+      artifact_t a;
+      if (artifact_init(&a, "libc.a", buildfile, NULL) && artifact_fetch(&a)) {
+        close(fd);
+        return false;
+      }
+      fprintf(stderr, "building %s/libc.a (core)...\n", lib_dir);
+      if (ninja("musl", buildfile, "libc-core") != 0)
+        errx(1, "failed to build %s/libc.a", lib_dir);
+    }
+    close(fd);
+  }
+
+  // Start building the complete libc.a unless another process is doing that
+  // or an earlier build of the same build file failed
+  int fd = open_lockfile(lockfile, "libc-tail");
+  if (flock(fd, LOCK_EX | LOCK_NB) == 0) {
+    if (lib_exists("libc.a")) {
+      close(fd);
+      return false;
+    }
+    if (libc_tail_failed(buildfile)) {
+      warnx("building the complete %s/libc.a failed; linking with its core only.\n"
+            "  To see why, build it with: %s/bin/ninja -C %s/src/musl -f %s\n"
+            "  or remove %s/.libc-tail.failed to retry in the background",
+            lib_dir, llvmbox_dir, llvmbox_dir, buildfile, lib_dir);
+    } else {
+      libc_tail_background(buildfile, objname, fd);
+    }
+  }
+  close(fd);
+  return true;
+}
+
+
+// link_with_libc_core runs clang with args, which link with the libc core.
+// If that fails, it waits for the complete libc.a and links again with full_args
+// (args without the libc core.) Does not return.
+static void link_with_libc_core(const char** args, const char** full_args) {
+  FILE* errf = tmpfile();
+  if (!errf)
+    err(1, "tmpfile");
+  pid_t pid = fork();
+  if (pid < 0)
+    err(1, "fork");
+  if (pid == 0) {
+    dup2(fileno(errf), STDERR_FILENO);
+    execv(args[0], (char*const*)args);
+    err(1, "exec %s", args[0]);
+  }
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR)
+      err(1, "waitpid");
+  }
+  bool ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+  if (!ok) {
+    // wait for the background build of the complete libc.a
+    char lockfile[PATH_MAX];
+    int fd = open_lockfile(lockfile, "libc-tail");
+    lock(fd, lockfile);
+    close(fd);
+    if (lib_exists("libc.a")) {
+      fclose(errf);
+      execv(full_args[0], (char*const*)full_args);
+      err(1, "exec %s", full_args[0]);
+    }
+  }
+
+  // forward diagnostics
+  char buf[4096];
+  usize n;
+  rewind(errf);
+  while ((n = fread(buf, 1, sizeof(buf), errf)) > 0)
+    fwrite(buf, 1, n, stderr);
+  exit(ok ? 0 : WIFEXITED(status) ? WEXITSTATUS(status) : 1);
+}
+
+
+static bool resolve_llvmbox_dir(const char* argv0) {
+  #ifdef __linux__
+    char exe[PATH_MAX];
+    isize n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    if (n > 0) {
+      exe[n] = 0;
+      return path_join(llvmbox_dir, exe, "../..") > 0;
+    }
+  #endif
+  const char* exe_path = get_exe_path(argv0);
+  return exe_path && path_join_resolve(llvmbox_dir, exe_path, "../..");
+}
+
+
+static const char* target_triple(const target_t* target) {
+  for (usize i = 0; i < SUPPORTED_TARGETS_COUNT; i++) {
+    const target_t* t = &supported_targets[i];
+    if (t->arch == target->arch && t->sys == target->sys && t->sysver == target->sysver)
+      return supported_target_triples[i];
+  }
+  return NULL;
+}
+
+
+static char* fmt(const char* format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  char* s;
+  if (vasprintf(&s, format, ap) < 0)
+    err(1, "vasprintf");
+  va_end(ap);
+  return s;
+}
+
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// response files
+//
+// The flags for a target are written once to response files which are passed to
+// clang as @file, so that an invocation doesn't need to look for the target's
+// include and library directories:
+//   targets/TARGET/cflags-ID.rsp  compiler flags
+//   lib_dir/ldflags-ID.rsp        linker flags (depends on the runtime variant)
+// ID is a hash of LLVMBOXID and the llvmbox directory, so an existing response
+// file is current (checking costs one stat) and a moved or upgraded llvmbox gets
+// new ones. When a response file can't be written (e.g. read-only llvmbox) the
+// flags are passed on the command line instead.
+
+typedef int(*flagsfn_t)(const char** args, const target_t* target);
+
+
+// dirflag appends flag+path to args if path is a directory.
+// path is relative to llvmbox_dir.
+static void dirflag(const char** args, int* nargs, const char* flag, const char* path) {
+  char* dir = fmt("%s/%s", llvmbox_dir, path);
+  if (isdir(dir)) {
+    args[(*nargs)++] = fmt("%s%s", flag, dir);
+  }
+  free(dir);
+}
+
+
+static int target_cflags(const char** args, const target_t* t) {
+  const char* arch = t->arch, *sys = t->sys, *sysver = t->sysver;
+  int n = 0;
+  args[n++] = fmt("--sysroot=%s/targets/%s", llvmbox_dir, targetid);
+  args[n++] = fmt("--target=%s", target_triple(t));
+  args[n++] = "-nostdinc";
+  args[n++] = "-ffreestanding";
+  args[n++] = "-fPIC";
+  if (strcmp(sys, "macos") == 0) {
+    // including TargetConditionals.h prevents "error: TARGET_OS_EMBEDDED is not defined"
+    args[n++] = "-Wno-nullability-completeness";
+    args[n++] = "-include";
+    args[n++] = "TargetConditionals.h";
+  }
+  char path[PATH_MAX];
+  if (*sysver) {
+    snprintf(path, sizeof(path), "targets/%s-%s.%s/include", arch, sys, sysver);
+    dirflag(args, &n, "-I", path);
+  }
+  snprintf(path, sizeof(path), "targets/%s-%s/include", arch, sys);
+  dirflag(args, &n, "-I", path);
+  snprintf(path, sizeof(path), "targets/any-%s/include", sys);
+  dirflag(args, &n, "-I", path);
+  return n;
+}
+
+
+static int target_ldflags(const char** args, const target_t* t) {
+  const char* arch = t->arch, *sys = t->sys, *sysver = t->sysver;
+  int n = 0;
+  args[n++] = fmt("-L%s", lib_dir);
+  char path[PATH_MAX];
+  if (*sysver) {
+    snprintf(path, sizeof(path), "targets/any-%s.%s/lib", sys, sysver);
+    dirflag(args, &n, "-L", path);
+    snprintf(path, sizeof(path), "targets/%s-%s/lib", arch, sys);
+    dirflag(args, &n, "-L", path);
+  }
+  snprintf(path, sizeof(path), "targets/any-%s/lib", sys);
+  dirflag(args, &n, "-L", path);
+  args[n++] = "-nostdlib";
+  args[n++] = "-lc";
+  args[n++] = "-lrt";
+  args[n++] = "-fPIE";
+  if (strcmp(sys, "linux") == 0) {
+    args[n++] = "-nostartfiles";
+    args[n++] = "-static";
+    args[n++] = fmt("%s/crt1.o", lib_dir);
+  }
+  return n;
+}
+
+
+// rsp_escape writes arg to f, escaped for clang's (GNU) response file syntax
+static void rsp_escape(FILE* f, const char* arg) {
+  for (const char* p = arg; *p; p++) {
+    if (strchr(" \t\n\"'\\", *p))
+      fputc('\\', f);
+    fputc(*p, f);
+  }
+  fputc('\n', f);
+}
+
+
+// rsp_id returns ID for response file names (see "response files")
+static const char* rsp_id() {
+  static char id[9];
+  if (!*id) {
+    u32 h = 2166136261u; // FNV-1a
+    for (const char* p = LLVMBOXID "\n"; *p; p++)
+      h = (h ^ (u8)*p) * 16777619u;
+    for (const char* p = llvmbox_dir; *p; p++)
+      h = (h ^ (u8)*p) * 16777619u;
+    snprintf(id, sizeof(id), "%08x", h);
+  }
+  return id;
+}
+
+
+// rsp_args appends "@dir/name-ID.rsp" to args, first writing the response file
+// with the flags produced by flagsfn if it doesn't exist. If it can't be written,
+// the flags themselves are appended. Returns the number of args appended.
+static int rsp_args(
+  const char** args, const char* dir, const char* name,
+  flagsfn_t flagsfn, const target_t* target)
+{
+  char* path = fmt("%s/%s-%s.rsp", dir, name, rsp_id());
+  struct stat st;
+  if (stat(path, &st) == 0) {
+    args[0] = fmt("@%s", path);
+    free(path);
+    return 1;
+  }
+
+  int n = flagsfn(args, target);
+  char* tmp = fmt("%s.%d.tmp", path, (int)getpid());
+  FILE* f = mkdirs(dir, 0755) ? fopen(tmp, "w") : NULL;
+  if (f) {
+    for (int i = 0; i < n; i++)
+      rsp_escape(f, args[i]);
+    if (fclose(f) == 0 && rename(tmp, path) == 0) {
+      args[0] = fmt("@%s", path);
+      n = 1;
+    } else {
+      unlink(tmp);
+    }
+  }
+  free(tmp);
+  free(path);
+  return n;
+}
+
+
+int main(int argc, char* argv[]) {
+  // clang-TARGET or clang++-TARGET
+  const char* progname = strrchr(argv[0], '/');
+  progname = progname ? progname + 1 : argv[0];
+  bool is_cxx = strncmp(progname, "clang++-", 8) == 0;
+  const char* clang = is_cxx ? "clang++" : "clang";
+  const char* target_arg;
+  if (is_cxx) {
+    target_arg = progname + 8;
+  } else if (strncmp(progname, "clang-", 6) == 0) {
+    target_arg = progname + 6;
+  } else {
+    errx(1, "must be invoked as clang-TARGET or clang++-TARGET (not %s)", progname);
+  }
+
+  // TARGET without system version (e.g. x86_64-macos) selects the oldest version
+  target_t target;
+  if (!target_parse(&target, target_arg, TARGET_PARSE_VALIDATE))
+    return 1;
+  const char* arch = target.arch;
+  bool is_linux = strcmp(target.sys, "linux") == 0;
+  target_str(target, targetid, sizeof(targetid));
+
+  if (!resolve_llvmbox_dir(argv[0]))
+    errx(1, "unable to resolve llvmbox directory");
+
+  // runtime variant (last of -flto and -fno-lto wins, as does last -march/-mcpu)
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-flto") == 0 || strncmp(argv[i], "-flto=", 6) == 0) {
+      variant_lto = true;
+    } else if (strcmp(argv[i], "-fno-lto") == 0) {
+      variant_lto = false;
+    } else if (strncmp(argv[i], "-march=", 7) == 0 || strncmp(argv[i], "-mcpu=", 6) == 0) {
+      variant_cpu = argv[i];
+    }
+  }
+  const char* tier = variant_cpu ? cpu_tier(variant_cpu) : NULL;
+  if (!tier)
+    variant_cpu = NULL;
+  snprintf(variant, sizeof(variant), "%s%s%s",
+    tier ? tier : "", tier && variant_lto ? "-" : "", variant_lto ? "lto" : "");
+  snprintf(lib_dir, sizeof(lib_dir), "%s/targets/%s/lib%s%s",
+    llvmbox_dir, targetid, *variant ? "-" : "", variant);
+
+  // link flags, unless compiling only (last of -c and -l* wins)
+  bool lflags = true;
+  bool has_lib_arg = false;
+  bool needs_cxx = false;
+  bool needs_malloc_fast = false;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    if (strncmp(a, "-l", 2) == 0) {
+      lflags = true;
+      has_lib_arg = true;
+      needs_cxx |= strcmp(a, "-lc++") == 0 || strcmp(a, "-lc++abi") == 0;
+      needs_malloc_fast |= is_linux && strcmp(a, "-lmalloc-fast") == 0;
+    } else if (strcmp(a, "-c") == 0 || strcmp(a, "-S") == 0 || strcmp(a, "-E") == 0 ||
+               strcmp(a, "-M") == 0 || strcmp(a, "-MM") == 0 ||
+               strcmp(a, "-fsyntax-only") == 0)
+    {
+      lflags = false;
+    }
+  }
+
+  // Build missing runtime libraries needed by the link. Nothing is built when
+  // compiling only. Since -nostdlib is used, libc++ is linked only when asked
+  // for with -lc++ (C-only and header-only C++ programs don't need it.)
+  bool libc_core_only = false;
+  if (lflags) {
+    char buildfile[128], objname[128];
+    libc_core_only = is_linux && ensure_libc(arch);
+    snprintf(buildfile, sizeof(buildfile), "build-%s.ninja", targetid);
+    snprintf(objname, sizeof(objname), "rt-%s", targetid);
+    ensure_lib("librt.a", "builtins", buildfile, objname, NULL);
+    if (needs_cxx) {
+      snprintf(objname, sizeof(objname), "cxx-%s", targetid);
+      ensure_lib("libc++.a", "libcxx", buildfile, objname, NULL);
+    }
+    if (needs_malloc_fast) {
+      // part of musl's build file; normally built along with libc
+      snprintf(buildfile, sizeof(buildfile), "build-%s.ninja", arch);
+      snprintf(objname, sizeof(objname), "musl-%s", arch);
+      ensure_lib("libmalloc-fast.a", "musl", buildfile, objname, "malloc-fast");
+    }
+  }
+
+  const char** args = malloc(sizeof(char*) * (usize)(argc + 64));
+  if (!args)
+    err(1, "malloc");
+  int n = 0;
+  args[n++] = fmt("%s/bin/%s", llvmbox_dir, clang);
+  args[n++] = fmt("-resource-dir=%s", lib_dir);
+  n += rsp_args(&args[n], fmt("%s/targets/%s", llvmbox_dir, targetid), "cflags",
+                target_cflags, &target);
+  int libc_core_arg = -1;
+  if (lflags) {
+    if (libc_core_only) {
+      libc_core_arg = n;
+      args[n++] = fmt("-L%s", libc_core_dir);
+    }
+    // must come before libc.a, which also defines malloc
+    if (needs_malloc_fast)
+      args[n++] = "-lmalloc-fast";
+    n += rsp_args(&args[n], lib_dir, "ldflags", target_ldflags, &target);
+  }
+
+  // user arguments
+  args[n++] = "-Wno-unused-command-line-argument";
+  if (is_linux) {
+    args[n++] = "-L-user-start";
+    if (has_lib_arg)
+      args[n++] = "-l-user-start";
+  }
+  args[n++] = "-Wunused-command-line-argument";
+  for (int i = 1; i < argc; i++)
+    args[n++] = argv[i];
+  args[n++] = "-Wno-unused-command-line-argument";
+  if (is_linux) {
+    if (has_lib_arg)
+      args[n++] = "-l-user-end";
+    args[n++] = "-L-user-end";
+  }
+  args[n] = NULL;
+
+  if (libc_core_arg > -1) {
+    const char** full_args = malloc(sizeof(char*) * (usize)(n + 1));
+    if (!full_args)
+      err(1, "malloc");
+    memcpy(full_args, args, sizeof(char*) * (usize)libc_core_arg);
+    memcpy(&full_args[libc_core_arg], &args[libc_core_arg + 1],
+      sizeof(char*) * (usize)(n - libc_core_arg)); // including NULL
+    link_with_libc_core(args, full_args);
+  }
+
+  execv(args[0], (char*const*)args);
+  err(1, "exec %s", args[0]);
+}
@@ -886,221 +886,321 @@ void sha256_close(sha256_t *sha_256) {
 //       void* ctx,                                             ← ctx position
 //       int (*cmp)(void* ctx, const void* x, const void* y));  ← cmp & ctx position
 //
-// For this reason we use qsort from musl.
-/* Copyright (C) 2011 by Valentin Ochs
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to
- * deal in the Software without restriction, including without limitation the
- * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
- * sell copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
- * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
- * IN THE SOFTWARE.
- */
-
-/*
-Minor changes by Rich Felker for integration in musl, 2011-04-27.
-
-Minor changes by Rasmus Andersson for integration in rsm, 2022-02-27.
- - Comparison with matching signed/unsigned integers
- - Use of __builtin_ctz (rsm_ctz) instead of a_ctz_{32,64} asm implementations
-
-Smoothsort, an adaptive variant of Heapsort.  Memory usage: O(1).
-Run time: Worst case O(n log n), close to O(n) in the mostly-sorted case.
-*/
-
-static inline int pntz(size_t p[2]) {
-  int r = lb_ctz(p[0] - 1);
-  if(r != 0 || (r = 8*sizeof(size_t) + lb_ctz(p[1])) != 8*sizeof(size_t)) {
-    return r;
+// For this reason we carry our own, the same pattern-defeating quicksort
+// (pdqsort) as qsort in our musl (sysroots/libc/musl/src/stdlib/qsort.c):
+// quicksort with branchless block partitioning, falling back to heapsort
+// after log2(n) badly unbalanced partitions. O(n) on sorted inputs and runs
+// of equal elements, O(n log n) worst case. Not stable.
+
+#define QSORT_INSERTION     12  // insertion sort partitions smaller than this
+#define QSORT_NINTHER       128 // pseudomedian of 9 for partitions larger than this
+#define QSORT_PARTIAL_LIMIT 8   // moves after which partial insertion sort gives up
+#define QSORT_BLOCK         64  // elements per partition block (offsets are u8)
+
+typedef enum { SWAP_BYTES, SWAP_WORDS, SWAP_4, SWAP_8, SWAP_16 } swaptype_t;
+
+typedef struct {
+  usize        width;
+  swaptype_t   swaptype;
+  lb_qsort_cmp cmp;
+  void*        arg;
+} sorter_t;
+
+// swaptype is fixed for the whole sort, so the switch is well predicted
+static inline void qsort_swap(const sorter_t* s, u8* a, u8* b) {
+  switch (s->swaptype) {
+    case SWAP_4: {
+      u32 x, y;
+      memcpy(&x, a, 4); memcpy(&y, b, 4);
+      memcpy(a, &y, 4); memcpy(b, &x, 4);
+      return;
+    }
+    case SWAP_8: {
+      u64 x, y;
+      memcpy(&x, a, 8); memcpy(&y, b, 8);
+      memcpy(a, &y, 8); memcpy(b, &x, 8);
+      return;
+    }
+    case SWAP_16: {
+      u64 x[2], y[2];
+      memcpy(x, a, 16); memcpy(y, b, 16);
+      memcpy(a, y, 16); memcpy(b, x, 16);
+      return;
+    }
+    case SWAP_WORDS:
+      for (usize n = s->width; n; n -= sizeof(usize), a += sizeof(usize), b += sizeof(usize)) {
+        usize x, y;
+        memcpy(&x, a, sizeof(usize)); memcpy(&y, b, sizeof(usize));
+        memcpy(a, &y, sizeof(usize)); memcpy(b, &x, sizeof(usize));
+      }
+      return;
+    case SWAP_BYTES:
+      for (usize n = s->width; n; n--, a++, b++) {
+        u8 t = *a;
+        *a = *b;
+        *b = t;
+      }
+      return;
   }
-  return 0;
 }
 
-static void cycle(size_t width, unsigned char* ar[], int n) {
-  unsigned char tmp[256];
-  size_t l;
-  int i;
+static inline int qsort_cmp(const sorter_t* s, const u8* a, const u8* b) {
+  return s->cmp(a, b, s->arg);
+}
 
-  if(n < 2) {
-    return;
+static void insertion_sort(const sorter_t* s, u8* lo, u8* hi) {
+  usize w = s->width;
+  for (u8* p = lo + w; p < hi; p += w) {
+    for (u8* q = p; q > lo && qsort_cmp(s, q - w, q) > 0; q -= w)
+      qsort_swap(s, q - w, q);
   }
+}
 
-  ar[n] = tmp;
-  while(width) {
-    l = sizeof(tmp) < width ? sizeof(tmp) : width;
-    memcpy(ar[n], ar[0], l);
-    for(i = 0; i < n; i++) {
-      memcpy(ar[i], ar[i + 1], l);
-      ar[i] += l;
+// partial_insertion_sort sorts [lo,hi) if that takes few moves.
+// Returns false, leaving the range permuted but unsorted, otherwise.
+static bool partial_insertion_sort(const sorter_t* s, u8* lo, u8* hi) {
+  usize w = s->width, moves = 0;
+  for (u8* p = lo + w; p < hi; p += w) {
+    for (u8* q = p; q > lo && qsort_cmp(s, q - w, q) > 0; q -= w) {
+      qsort_swap(s, q - w, q);
+      if (++moves > QSORT_PARTIAL_LIMIT)
+        return false;
     }
-    width -= l;
   }
+  return true;
 }
 
-/* shl() and shr() need n > 0 */
-static inline void shl(size_t p[2], int n) {
-  if(n >= (int)(8 * sizeof(size_t))) {
-    n -= (int)(8 * sizeof(size_t));
-    p[1] = p[0];
-    p[0] = 0;
+static void sift_down(const sorter_t* s, u8* base, usize root, usize n) {
+  usize w = s->width, child;
+  while ((child = 2*root + 1) < n) {
+    if (child + 1 < n && qsort_cmp(s, base + child*w, base + (child + 1)*w) < 0)
+      child++;
+    if (qsort_cmp(s, base + root*w, base + child*w) >= 0)
+      return;
+    qsort_swap(s, base + root*w, base + child*w);
+    root = child;
   }
-  p[1] <<= n;
-  p[1] |= p[0] >> (sizeof(size_t) * 8 - n);
-  p[0] <<= n;
 }
 
-static inline void shr(size_t p[2], int n) {
-  if(n >= (int)(8 * sizeof(size_t))) {
-    n -= (int)(8 * sizeof(size_t));
-    p[0] = p[1];
-    p[1] = 0;
+static void heap_sort(const sorter_t* s, u8* lo, u8* hi) {
+  usize w = s->width, n = (usize)(hi - lo) / w;
+  for (usize i = n/2; i-- > 0; )
+    sift_down(s, lo, i, n);
+  for (usize i = n; --i > 0; ) {
+    qsort_swap(s, lo, lo + i*w);
+    sift_down(s, lo, 0, i);
   }
-  p[0] >>= n;
-  p[0] |= p[1] << (sizeof(size_t) * 8 - n);
-  p[1] >>= n;
 }
 
-static void sift(
-  unsigned char *head, size_t width, lb_qsort_cmp cmp,
-  void *arg, int pshift, size_t lp[])
-{
-  unsigned char *rt, *lf;
-  unsigned char *ar[14 * sizeof(size_t) + 1];
-  int i = 1;
-
-  ar[0] = head;
-  while(pshift > 1) {
-    rt = head - width;
-    lf = head - width - lp[pshift - 2];
-
-    if(cmp(ar[0], lf, arg) >= 0 && cmp(ar[0], rt, arg) >= 0) {
-      break;
-    }
-    if(cmp(lf, rt, arg) >= 0) {
-      ar[i++] = lf;
-      head = lf;
-      pshift -= 1;
-    } else {
-      ar[i++] = rt;
-      head = rt;
-      pshift -= 2;
-    }
+static inline void sort3(const sorter_t* s, u8* a, u8* b, u8* c) {
+  if (qsort_cmp(s, b, a) < 0)
+    qsort_swap(s, a, b);
+  if (qsort_cmp(s, c, b) < 0) {
+    qsort_swap(s, b, c);
+    if (qsort_cmp(s, b, a) < 0)
+      qsort_swap(s, a, b);
   }
-  cycle(width, ar, i);
 }
 
-static void trinkle(
-  unsigned char *head, size_t width, lb_qsort_cmp cmp,
-  void *arg, size_t pp[2], int pshift, int trusty, size_t lp[])
-{
-  unsigned char *stepson,
-                *rt, *lf;
-  size_t p[2];
-  unsigned char *ar[14 * sizeof(size_t) + 1];
-  int i = 1;
-  int trail;
-
-  p[0] = pp[0];
-  p[1] = pp[1];
-
-  ar[0] = head;
-  while(p[0] != 1 || p[1] != 0) {
-    stepson = head - lp[pshift];
-    if(cmp(stepson, ar[0], arg) <= 0) {
-      break;
+// partition_right partitions [lo,hi) around the pivot at lo into elements
+// less than it, the pivot, and elements greater or equal.
+// Returns the pivot's new position; sets *already if nothing had to move.
+// Elements are classified a block at a time into arrays of offsets by adding
+// the comparison result to a count rather than branching on it, then swapped.
+static u8* partition_right(const sorter_t* s, u8* lo, u8* hi, bool* already) {
+  usize w = s->width;
+  u8* pivot = lo;
+  u8* first = lo;
+  u8* last = hi;
+  u8 offl[QSORT_BLOCK], offr[QSORT_BLOCK];
+  usize numl = 0, numr = 0, startl = 0, startr = 0;
+
+  // a consistent cmp would have both scans stop at the median of 3, but they
+  // are bounded so that one that isn't can't take them outside [lo,hi).
+  // If they cross, nothing needs to move.
+  while ((first += w) < last && qsort_cmp(s, first, pivot) < 0) {}
+  while (first < last && qsort_cmp(s, last -= w, pivot) >= 0) {}
+
+  *already = first >= last;
+  if (!*already) {
+    qsort_swap(s, first, last);
+    first += w;
+    u8* basel = first;
+    u8* baser = last;
+    while (first < last) {
+      usize unknown = (usize)(last - first) / w;
+      usize lsplit = numl ? 0 : numr ? unknown : unknown/2;
+      usize rsplit = numr ? 0 : unknown - lsplit;
+      lsplit = MIN_X(lsplit, (usize)QSORT_BLOCK);
+      rsplit = MIN_X(rsplit, (usize)QSORT_BLOCK);
+      for (usize i = 0; i < lsplit; i++, first += w) {
+        offl[numl] = (u8)i;
+        numl += qsort_cmp(s, first, pivot) >= 0;
+      }
+      for (usize i = 0; i < rsplit; ) {
+        offr[numr] = (u8)++i;
+        numr += qsort_cmp(s, last -= w, pivot) < 0;
+      }
+      usize n = MIN_X(numl, numr);
+      for (usize i = 0; i < n; i++)
+        qsort_swap(s, basel + offl[startl + i]*w, baser - offr[startr + i]*w);
+      numl -= n; numr -= n;
+      startl += n; startr += n;
+      if (numl == 0) {
+        startl = 0;
+        basel = first;
+      }
+      if (numr == 0) {
+        startr = 0;
+        baser = last;
+      }
     }
-    if(!trusty && pshift > 1) {
-      rt = head - width;
-      lf = head - width - lp[pshift - 2];
-      if(cmp(rt, stepson, arg) >= 0 || cmp(lf, stepson, arg) >= 0) {
-        break;
+    // at most one side has misplaced elements left; move them to the boundary
+    if (numl) {
+      while (numl--)
+        qsort_swap(s, basel + offl[startl + numl]*w, last -= w);
+      first = last;
+    }
+    if (numr) {
+      while (numr--) {
+        qsort_swap(s, baser - offr[startr + numr]*w, first);
+        first += w;
       }
     }
-
-    ar[i++] = stepson;
-    head = stepson;
-    trail = pntz(p);
-    shr(p, trail);
-    pshift += trail;
-    trusty = 0;
-  }
-  if(!trusty) {
-    cycle(width, ar, i);
-    sift(head, width, cmp, arg, pshift, lp);
   }
+  qsort_swap(s, pivot, first - w);
+  return first - w;
 }
 
-void lb_qsort(void *base, size_t nel, size_t width, lb_qsort_cmp cmp, void* arg) {
-  size_t lp[12*sizeof(size_t)];
-  size_t i, size = width * nel;
-  unsigned char *head, *high;
-  size_t p[2] = {1, 0};
-  int pshift = 1;
-  int trail;
+// partition_left partitions [lo,hi) around the pivot at lo into elements
+// equal to it and elements greater. It is used when the pivot equals the
+// element before lo, which is no greater than any in [lo,hi), to skip runs
+// of equal elements in one pass. Returns the pivot's new position.
+static u8* partition_left(const sorter_t* s, u8* lo, u8* hi) {
+  usize w = s->width;
+  u8* pivot = lo;
+  u8* first = lo;
+  u8* last = hi;
+
+  // bounded like the scans of partition_right
+  while (last > first && qsort_cmp(s, pivot, last -= w) < 0) {}
+  while (first < last && qsort_cmp(s, pivot, first += w) >= 0) {}
+
+  while (first < last) {
+    qsort_swap(s, first, last);
+    while (last > first && qsort_cmp(s, pivot, last -= w) < 0) {}
+    while (first < last && qsort_cmp(s, pivot, first += w) >= 0) {}
+  }
+  qsort_swap(s, pivot, last);
+  return last;
+}
 
-  if (!size) return;
+static void pdqsort(const sorter_t* s, u8* lo, u8* hi, int bad, bool leftmost) {
+  usize w = s->width;
 
-  head = base;
-  high = head + size - width;
+  for (;;) {
+    usize n = (usize)(hi - lo) / w;
+    u8* mid = lo + (n/2)*w;
 
-  /* Precompute Leonardo numbers, scaled by element width */
-  for(lp[0]=lp[1]=width, i=2; (lp[i]=lp[i-2]+lp[i-1]+width) < size; i++);
+    if (n < QSORT_INSERTION) {
+      insertion_sort(s, lo, hi);
+      return;
+    }
 
-  while(head < high) {
-    if((p[0] & 3) == 3) {
-      sift(head, width, cmp, arg, pshift, lp);
-      shr(p, 2);
-      pshift += 2;
+    // move the median of 3, or pseudomedian of 9, to lo.
+    // Either way the ends now hold elements no less and no greater than it.
+    if (n > QSORT_NINTHER) {
+      sort3(s, lo, mid, hi - w);
+      sort3(s, lo + w, mid - w, hi - 2*w);
+      sort3(s, lo + 2*w, mid + w, hi - 3*w);
+      sort3(s, mid - w, mid, mid + w);
+      qsort_swap(s, lo, mid);
     } else {
-      if ((isize)lp[pshift - 1] >= (isize)(high - head)) {
-        trinkle(head, width, cmp, arg, p, pshift, 0, lp);
-      } else {
-        sift(head, width, cmp, arg, pshift, lp);
-      }
+      sort3(s, mid, lo, hi - w);
+    }
 
-      if(pshift == 1) {
-        shl(p, 1);
-        pshift = 0;
-      } else {
-        shl(p, pshift - 1);
-        pshift = 1;
-      }
+    // a pivot equal to the previous one means there is no element less than
+    // it in this partition; skip all that are equal
+    if (!leftmost && qsort_cmp(s, lo - w, lo) >= 0) {
+      lo = partition_left(s, lo, hi) + w;
+      continue;
     }
 
-    p[0] |= 1;
-    head += width;
-  }
+    bool already;
+    u8* p = partition_right(s, lo, hi, &already);
+    usize nl = (usize)(p - lo) / w;
+    usize nr = (usize)(hi - p) / w - 1;
 
-  trinkle(head, width, cmp, arg, p, pshift, 0, lp);
+    if (nl < n/8 || nr < n/8) {
+      // badly unbalanced. After too many of these, switch to heapsort;
+      // until then, swap some elements around to break up the pattern.
+      if (--bad == 0) {
+        heap_sort(s, lo, hi);
+        return;
+      }
+      if (nl >= QSORT_INSERTION) {
+        qsort_swap(s, lo, lo + (nl/4)*w);
+        qsort_swap(s, p - w, p - (nl/4)*w);
+        if (nl > QSORT_NINTHER) {
+          qsort_swap(s, lo + w, lo + (nl/4 + 1)*w);
+          qsort_swap(s, lo + 2*w, lo + (nl/4 + 2)*w);
+          qsort_swap(s, p - 2*w, p - (nl/4 + 1)*w);
+          qsort_swap(s, p - 3*w, p - (nl/4 + 2)*w);
+        }
+      }
+      if (nr >= QSORT_INSERTION) {
+        qsort_swap(s, p + w, p + (1 + nr/4)*w);
+        qsort_swap(s, hi - w, hi - (nr/4)*w);
+        if (nr > QSORT_NINTHER) {
+          qsort_swap(s, p + 2*w, p + (2 + nr/4)*w);
+          qsort_swap(s, p + 3*w, p + (3 + nr/4)*w);
+          qsort_swap(s, hi - 2*w, hi - (1 + nr/4)*w);
+          qsort_swap(s, hi - 3*w, hi - (2 + nr/4)*w);
+        }
+      }
+    } else if (already &&
+               partial_insertion_sort(s, lo, p) &&
+               partial_insertion_sort(s, p + w, hi))
+    {
+      // the input was likely sorted already
+      return;
+    }
 
-  while(pshift != 1 || p[0] != 1 || p[1] != 0) {
-    if(pshift <= 1) {
-      trail = pntz(p);
-      shr(p, trail);
-      pshift += trail;
+    // recurse into the smaller side to bound stack depth
+    if (nl < nr) {
+      pdqsort(s, lo, p, bad, leftmost);
+      lo = p + w;
+      leftmost = false;
     } else {
-      shl(p, 2);
-      pshift -= 2;
-      p[0] ^= 7;
-      shr(p, 1);
-      trinkle(head - lp[pshift] - width, width, cmp, arg, p, pshift + 1, 1, lp);
-      shl(p, 1);
-      p[0] |= 1;
-      trinkle(head - width, width, cmp, arg, p, pshift, 1, lp);
+      pdqsort(s, p + w, hi, bad, false);
+      hi = p;
     }
-    head -= width;
   }
 }
 
+void lb_qsort(void* base, usize nel, usize width, lb_qsort_cmp cmp, void* arg) {
+  sorter_t s = { width, SWAP_BYTES, cmp, arg };
+  uintptr a = (uintptr)base;
+  int bad = 0;
+
+  if (nel < 2 || width == 0)
+    return;
+
+  if (width == 4 && a % 4 == 0) {
+    s.swaptype = SWAP_4;
+  } else if (width == 8 && a % 8 == 0) {
+    s.swaptype = SWAP_8;
+  } else if (width == 16 && a % 8 == 0) {
+    s.swaptype = SWAP_16;
+  } else if ((a | width) % sizeof(usize) == 0) {
+    s.swaptype = SWAP_WORDS;
+  }
+
+  // allow log2(nel) badly unbalanced partitions
+  while (nel >> bad)
+    bad++;
+
+  pdqsort(&s, base, (u8*)base + nel*width, bad, true);
+}
+
 
@@ -5,14 +5,27 @@ SELF_SCRIPT=$(realpath "$0")
 cd "$(dirname "$0")"
 PROJECT=$(realpath "$PWD/..")
 ENABLE_LTO=false
+ENABLE_PGO=false
+ENABLE_PGO_LAYOUT=false
 LLVM_CONFIG="$PROJECT/out/llvmbox-dev/bin/llvm-config"
+DEV_LIBDIR="$PROJECT/out/llvmbox-dev/lib"
+DRIVER_OBJ="$DEV_LIBDIR/llvm_clang_lld_driver.o"
+LLVM_SRC=${LLVM_SRC:-$PROJECT/out/src/llvm}
 
 _err() { echo -e "$0:" "$@" >&2 ; exit 1; }
-_usage() { echo "usage: $0 [--lto] <llvmroot>"; }
+_usage() {
+  echo "usage: $0 [options] <llvmroot>"
+  echo "options:"
+  echo "  --lto         Build with ThinLTO, using lib-lto libraries"
+  echo "  --pgo         Build a profile-optimized myclang (implies --lto)"
+  echo "  --pgo-layout  With --pgo, also order functions by hotness at link time"
+}
 
 while [[ $# -gt 0 ]]; do case "$1" in
   -h*|--help) _usage; exit 0 ;;
   --lto|-lto) ENABLE_LTO=true; shift ;;
+  --pgo)        ENABLE_PGO=true; ENABLE_LTO=true; shift ;;
+  --pgo-layout) ENABLE_PGO=true; ENABLE_PGO_LAYOUT=true; ENABLE_LTO=true; shift ;;
   *)
     [ -z "$LLVM_ROOT" ] || _err "unexpected extra argument \"$1\""
     LLVM_ROOT=`cd "$PWD0"; realpath "$1"`; shift
@@ -44,20 +57,18 @@ LDFLAGS=( -gz=zlib )
 # macos: 0m0.887s  120,090,320 B (89,755,888 stripped)
 # linux: 0m0.486s  116,912,576 B (96,382,304 stripped)
 #
+# LTO disabled, linux (link with prelinked llvm_clang_lld_driver.o)
+# This object only contains code reachable from the clang & lld drivers and
+# has no archive members to resolve. If our sources use something that was
+# garbage-collected from it, we fall back to liball_llvm_clang_lld.a.
+#
 if $ENABLE_LTO; then
   CFLAGS+=( -flto=thin )
   CXXFLAGS+=( -flto=thin )
   LDFLAGS+=( -flto=thin -L"$PROJECT"/out/llvmbox-dev/lib-lto )
-  case "$(uname -s)" in
-    Linux)  LDFLAGS+=( "-Wl,--thinlto-cache-dir=$BUILD_DIR/lto-cache" ) ;;
-    Darwin) LDFLAGS+=( "-Wl,-cache_path_lto,$BUILD_DIR/lto-cache" ) ;;
-  esac
   LDFLAGS+=( "$PROJECT"/out/llvmbox-dev/lib-lto/lib{clang,lld,LLVM}*.a )
 else
-  LDFLAGS+=(
-    -L"$PROJECT"/out/llvmbox-dev/lib \
-    "$PROJECT"/out/llvmbox-dev/lib/liball_llvm_clang_lld.a \
-  )
+  LDFLAGS+=( -L"$DEV_LIBDIR" )
 fi
 
 LDFLAGS+=( $("$LLVM_CONFIG" --system-libs) )
@@ -66,37 +77,158 @@ CFLAGS=( "${C_AND_CXX_FLAGS[@]}" "${CFLAGS[@]}" )
 CXXFLAGS=( "${C_AND_CXX_FLAGS[@]}" "${CXXFLAGS[@]}" )
 [ "$(uname -s)" = Linux ] && LDFLAGS+=( -static )
 
-mkdir -p "$BUILD_DIR"
-echo "target $(uname -ms)"      > "$BUILD_DIR/config.tmp"
-echo "CFLAGS ${CFLAGS[@]}"     >> "$BUILD_DIR/config.tmp"
-echo "CXXFLAGS ${CXXFLAGS[@]}" >> "$BUILD_DIR/config.tmp"
-# echo "LDFLAGS ${LDFLAGS[@]}"   >> "$BUILD_DIR/config.tmp"
-echo "SRC ${SOURCES[@]}"       >> "$BUILD_DIR/config.tmp"
-if ! diff -q "$BUILD_DIR/config" "$BUILD_DIR/config.tmp" >/dev/null 2>&1; then
-  [ -e "$BUILD_DIR/config" ] && echo "build configuration changed"
-  mv "$BUILD_DIR/config.tmp" "$BUILD_DIR/config"
-  rm -rf "$BUILD_DIR/lto-cache" "$BUILD_DIR"/*.o
-else
-  rm "$BUILD_DIR/config.tmp"
-fi
+_build() { # <builddir> <outfile> [<ldflag> ...]
+  local BUILD_DIR=$1 ; shift
+  local OUTFILE=$1 ; shift
+  local LDFLAGS=( "${LDFLAGS[@]}" "$@" )
+  if $ENABLE_LTO; then
+    case "$(uname -s)" in
+      Linux)  LDFLAGS+=( "-Wl,--thinlto-cache-dir=$BUILD_DIR/lto-cache" ) ;;
+      Darwin) LDFLAGS+=( "-Wl,-cache_path_lto,$BUILD_DIR/lto-cache" ) ;;
+    esac
+  fi
 
-OBJECTS=()
-for f in "${SOURCES[@]}"; do
-  obj=$BUILD_DIR/$f.o
-  OBJECTS+=( "$obj" )
-  [ -e "$obj" -a "$obj" -nt "$f" ] && continue
-  if [[ "$f" == *.cc ]]; then
-    echo "$LLVM_ROOT"/bin/clang++ "${CXXFLAGS[@]}" -c -o $obj $f
-         "$LLVM_ROOT"/bin/clang++ "${CXXFLAGS[@]}" -c -o $obj $f &
+  mkdir -p "$BUILD_DIR"
+  echo "target $(uname -ms)"      > "$BUILD_DIR/config.tmp"
+  echo "CFLAGS ${CFLAGS[@]}"     >> "$BUILD_DIR/config.tmp"
+  echo "CXXFLAGS ${CXXFLAGS[@]}" >> "$BUILD_DIR/config.tmp"
+  # echo "LDFLAGS ${LDFLAGS[@]}"   >> "$BUILD_DIR/config.tmp"
+  echo "SRC ${SOURCES[@]}"       >> "$BUILD_DIR/config.tmp"
+  if ! diff -q "$BUILD_DIR/config" "$BUILD_DIR/config.tmp" >/dev/null 2>&1; then
+    [ -e "$BUILD_DIR/config" ] && echo "build configuration changed"
+    mv "$BUILD_DIR/config.tmp" "$BUILD_DIR/config"
+    rm -rf "$BUILD_DIR/lto-cache" "$BUILD_DIR"/*.o
   else
-    echo "$LLVM_ROOT"/bin/clang "${CFLAGS[@]}" -c -o $obj $f
-         "$LLVM_ROOT"/bin/clang "${CFLAGS[@]}" -c -o $obj $f &
+    rm "$BUILD_DIR/config.tmp"
+  fi
+
+  local OBJECTS=() f obj
+  for f in "${SOURCES[@]}"; do
+    obj=$BUILD_DIR/$f.o
+    OBJECTS+=( "$obj" )
+    [ -e "$obj" -a "$obj" -nt "$f" ] && continue
+    if [[ "$f" == *.cc ]]; then
+      echo "$LLVM_ROOT"/bin/clang++ "${CXXFLAGS[@]}" -c -o $obj $f
+           "$LLVM_ROOT"/bin/clang++ "${CXXFLAGS[@]}" -c -o $obj $f &
+    else
+      echo "$LLVM_ROOT"/bin/clang "${CFLAGS[@]}" -c -o $obj $f
+           "$LLVM_ROOT"/bin/clang "${CFLAGS[@]}" -c -o $obj $f &
+    fi
+  done
+  wait
+
+  echo "$LLVM_ROOT"/bin/clang++ "${LDFLAGS[@]}" "${OBJECTS[@]}" -o "$OUTFILE"
+  time "$LLVM_ROOT"/bin/clang++ "${LDFLAGS[@]}" "${OBJECTS[@]}" -o "$OUTFILE"
+}
+
+# ——————————————————————————————————————————————————————————————————————————————————————
+# PGO (--pgo)
+#
+# The LLVM, clang and lld code in lib-lto is already compiled to bitcode, so we use
+# context-sensitive PGO, which instruments and optimizes at (Thin)LTO link time and
+# thus covers all of myclang, not just the sources in this directory:
+#   1. build an instrumented myclang (-fcs-profile-generate)
+#   2. compile a workload with it: musl (src/musl of <llvmroot>) and, if the llvm
+#      source is available at $LLVM_SRC, libc++
+#   3. merge the profiles with llvm-profdata
+#   4. rebuild myclang with -fprofile-use (lld picks up the CS profile)
+#   5. (--pgo-layout) order functions by profiled entry count and relink
+# Finally the workload is timed with a non-PGO build and with the PGO build.
+#
+PGO_DIR=$PWD/$BUILD_DIR/pgo
+
+_pgo_workload() { # <myclang> <outdir>
+  local cc=$1 outdir=$2 arch=$(uname -m) f
+  [ "$arch" != arm64 ] || arch=aarch64
+  rm -rf "$outdir"
+  mkdir -p "$outdir"
+
+  # musl, using the same build file as the lazy libc build of clang-TARGET.
+  # -fno-lto is added since "myclang cc" defaults to -flto and we want the
+  # profile to include code generation.
+  sed -e "s|^obj = .*|obj = $outdir/musl|" \
+      -e "s|^objcache = .*|objcache = $outdir/objcache|" \
+      -e "s|^libdir = .*|libdir = $outdir/lib|" \
+      -e "s|\.\./\.\./bin/clang |$cc cc -fno-lto |" \
+      "$LLVM_ROOT/src/musl/build-$arch.ninja" > "$outdir/musl.ninja"
+  ( cd "$LLVM_ROOT/src/musl" && "$LLVM_ROOT/bin/ninja" -f "$outdir/musl.ninja" >/dev/null )
+
+  # libc++ (optional)
+  [ -d "$LLVM_SRC/libcxx/src" ] || return 0
+  local cxxflags=( -fno-lto -Os -std=c++20 -w -nostdinc++ -D_LIBCPP_BUILDING_LIBRARY \
+                   -I"$LLVM_SRC/libcxx/src" )
+  for f in "$LLVM_ROOT"/sysroot/include/{,*/}c++/v1; do
+    [ -d "$f" ] && cxxflags+=( -isystem "$f" )
+  done
+  cat << END > "$outdir/libcxx.ninja"
+rule cxx
+  command = $cc c++ ${cxxflags[@]} -c -o \$out \$in
+END
+  for f in "$LLVM_SRC"/libcxx/src/*.cpp; do
+    echo "build $outdir/libcxx/$(basename "$f").o: cxx $f" >> "$outdir/libcxx.ninja"
+  done
+  # some libc++ sources need configuration we don't replicate; that's fine
+  "$LLVM_ROOT/bin/ninja" -f "$outdir/libcxx.ninja" -k 0 >/dev/null || true
+}
+
+_pgo_time_workload() { # <myclang>
+  local TIMEFORMAT=%R
+  { time _pgo_workload "$1" "$PGO_DIR/workload" >/dev/null 2>&1 ; } 2>&1
+}
+
+if $ENABLE_PGO; then
+  PROFDATA=$PGO_DIR/myclang.profdata
+  ORDER_FILE=$PGO_DIR/myclang.order
+  mkdir -p "$PGO_DIR"
+
+  echo "—— pgo: building instrumented myclang"
+  _build "$BUILD_DIR/pgo-instr" "$PGO_DIR/myclang-instr" \
+    -fcs-profile-generate="$PGO_DIR/profraw"
+
+  echo "—— pgo: running workload"
+  rm -rf "$PGO_DIR/profraw"
+  LLVM_PROFILE_FILE="$PGO_DIR/profraw/%4m.profraw" \
+    _pgo_workload "$PGO_DIR/myclang-instr" "$PGO_DIR/workload"
+  "$LLVM_ROOT"/bin/llvm-profdata merge -o "$PROFDATA" "$PGO_DIR"/profraw/*.profraw
+
+  echo "—— pgo: building optimized myclang"
+  PGO_LDFLAGS=( -fprofile-use="$PROFDATA" )
+  if $ENABLE_PGO_LAYOUT; then
+    # "Function count" is the entry count; names of internal symbols are
+    # prefixed with "file;" in the profile
+    "$LLVM_ROOT"/bin/llvm-profdata show --showcs --all-functions "$PROFDATA" |
+      awk '/^  [^ ].*:$/ { name = substr($0, 3, length($0) - 3); sub(/^.*;/, "", name) }
+           /Function count:/ { if (name != "" && $3 > 0) print $3, name; name = "" }' |
+      sort -rn -k1,1 | awk '!seen[$2]++ { print $2 }' > "$ORDER_FILE"
+    echo "ordering $(wc -l < "$ORDER_FILE" | tr -d ' ') hot functions"
+    case "$(uname -s)" in
+      Linux)  PGO_LDFLAGS+=( -Wl,--symbol-ordering-file="$ORDER_FILE" \
+                             -Wl,--no-warn-symbol-ordering ) ;;
+      Darwin) PGO_LDFLAGS+=( -Wl,-order_file,"$ORDER_FILE" ) ;;
+    esac
   fi
-done
-wait
+  # the ThinLTO cache key includes the profile's path but not its content
+  rm -rf "$BUILD_DIR/pgo-use/lto-cache"
+  _build "$BUILD_DIR/pgo-use" myclang "${PGO_LDFLAGS[@]}"
+
+  echo "—— pgo: building non-PGO myclang for comparison"
+  _build "$BUILD_DIR/pgo-base" "$PGO_DIR/myclang-base"
 
-echo "$LLVM_ROOT"/bin/clang++ "${LDFLAGS[@]}" "${OBJECTS[@]}" -o myclang
-time "$LLVM_ROOT"/bin/clang++ "${LDFLAGS[@]}" "${OBJECTS[@]}" -o myclang
+  echo "—— pgo: timing workload"
+  T_BASE=$(_pgo_time_workload "$PGO_DIR/myclang-base")
+  T_PGO=$(_pgo_time_workload "$PWD/myclang")
+  awk "BEGIN { printf \"workload: %.2fs without PGO, %.2fs with PGO (%.2fx speedup)\\n\", \
+               $T_BASE, $T_PGO, $T_BASE / $T_PGO }"
+elif $ENABLE_LTO; then
+  _build "$BUILD_DIR" myclang
+elif [ -f "$DRIVER_OBJ" ] && _build "$BUILD_DIR" myclang "$DRIVER_OBJ"; then
+  :
+else
+  [ -f "$DRIVER_OBJ" ] &&
+    echo "WARNING! linking with $(basename "$DRIVER_OBJ") failed;" \
+         "using liball_llvm_clang_lld.a" >&2
+  _build "$BUILD_DIR" myclang "$DEV_LIBDIR/liball_llvm_clang_lld.a"
+fi
 
 [ -L ld64.lld ] || ln -sfv myclang ld64.lld
 [ -L ld.lld ] || ln -sfv myclang ld.lld
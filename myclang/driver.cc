@@ -50,6 +50,7 @@
 #include <memory>
 #include <set>
 #include <system_error>
+#include "myclang.h"
 using namespace clang;
 using namespace clang::driver;
 using namespace llvm::opt;
@@ -333,8 +334,6 @@ extern "C" int clang_main(int Argc, char **Argv) {
   if (llvm::sys::Process::FixupStandardFileDescriptors())
     return 1;
 
-  llvm::InitializeAllTargets();
-
   llvm::BumpPtrAllocator A;
   llvm::StringSaver Saver(A);
 
@@ -476,7 +475,12 @@ extern "C" int clang_main(int Argc, char **Argv) {
     llvm::CrashRecoveryContext::Enable();
   }
 
+  // Only register the target we are compiling for (instead of all targets)
+  MyclangInitializeTargets(Args, MYCLANG_INIT_TARGET);
+
+  uint64_t ParseStart = myclang_prof_now();
   std::unique_ptr<Compilation> C(TheDriver.BuildCompilation(Args));
+  myclang_prof_add("option parsing", ParseStart);
 
   Driver::ReproLevel ReproLevel = Driver::ReproLevel::OnCrash;
   if (Arg *A = C->getArgs().getLastArg(options::OPT_gen_reproducer_eq)) {
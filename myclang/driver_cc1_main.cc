@@ -45,6 +45,7 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
 #include <cstdio>
+#include "myclang.h"
 
 #ifdef CLANG_HAVE_RLIMITS
 #include <sys/resource.h>
@@ -193,10 +194,9 @@ int cc1_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
   PCHOps->registerReader(std::make_unique<ObjectFilePCHContainerReader>());
 
   // Initialize targets first, so that --version shows registered targets.
-  llvm::InitializeAllTargets();
-  llvm::InitializeAllTargetMCs();
-  llvm::InitializeAllAsmPrinters();
-  llvm::InitializeAllAsmParsers();
+  // (myclang: only the target named by -triple, unless e.g. --version is set)
+  MyclangInitializeTargets(Argv, MYCLANG_INIT_TARGET | MYCLANG_INIT_TARGET_MC |
+                                 MYCLANG_INIT_ASM_PRINTER | MYCLANG_INIT_ASM_PARSER);
 
   // Buffer diagnostics from argument parsing so that we can output them using a
   // well formed diagnostic object.
@@ -209,8 +209,10 @@ int cc1_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
     Diags.setSeverity(diag::remark_cc1_round_trip_generated,
                       diag::Severity::Remark, {});
 
+  uint64_t ParseStart = myclang_prof_now();
   bool Success = CompilerInvocation::CreateFromArgs(Clang->getInvocation(),
                                                     Argv, Diags, Argv0);
+  myclang_prof_add("option parsing", ParseStart);
 
   if (Clang->getFrontendOpts().TimeTrace ||
       !Clang->getFrontendOpts().TimeTracePath.empty()) {
@@ -55,6 +55,12 @@
 #include "llvm/Support/raw_ostream.h"
 #include <memory>
 #include <system_error>
+#include "llvm/Support/StringSaver.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include <atomic>
+#include <mutex>
+#include "myclang.h"
 using namespace clang;
 using namespace clang::driver;
 using namespace clang::driver::options;
@@ -351,7 +357,8 @@ getOutputStream(StringRef Path, DiagnosticsEngine &Diags, bool Binary) {
 }
 
 static bool ExecuteAssemblerImpl(AssemblerInvocation &Opts,
-                                 DiagnosticsEngine &Diags) {
+                                 DiagnosticsEngine &Diags,
+                                 raw_ostream *DiagOS) {
   // Get the target specific parser.
   std::string Error;
   const Target *TheTarget = TargetRegistry::lookupTarget(Opts.Triple, Error);
@@ -375,6 +382,14 @@ static bool ExecuteAssemblerImpl(AssemblerInvocation &Opts,
   // it later.
   SrcMgr.setIncludeDirs(Opts.IncludePaths);
 
+  // myclang: in batch mode, print assembler diagnostics to the job's own
+  // stream rather than to errs(), which other jobs' threads write to.
+  if (DiagOS) {
+    SrcMgr.setDiagHandler([](const SMDiagnostic &D, void *OS) {
+      D.print(nullptr, *static_cast<raw_ostream *>(OS));
+    }, DiagOS);
+  }
+
   std::unique_ptr<MCRegisterInfo> MRI(TheTarget->createMCRegInfo(Opts.Triple));
   assert(MRI && "Unable to create target register info!");
 
@@ -411,6 +426,13 @@ static bool ExecuteAssemblerImpl(AssemblerInvocation &Opts,
 
   MCContext Ctx(Triple(Opts.Triple), MAI.get(), MRI.get(), STI.get(), &SrcMgr,
                 &MCOptions);
+  if (DiagOS) {
+    Ctx.setDiagnosticHandler([DiagOS](const SMDiagnostic &D, bool,
+                                      const SourceMgr &,
+                                      std::vector<const MDNode *> &) {
+      D.print(nullptr, *DiagOS);
+    });
+  }
 
   bool PIC = false;
   if (Opts.RelocationModel == "static") {
@@ -557,8 +579,9 @@ static bool ExecuteAssemblerImpl(AssemblerInvocation &Opts,
 }
 
 static bool ExecuteAssembler(AssemblerInvocation &Opts,
-                             DiagnosticsEngine &Diags) {
-  bool Failed = ExecuteAssemblerImpl(Opts, Diags);
+                             DiagnosticsEngine &Diags,
+                             raw_ostream *DiagOS = nullptr) {
+  bool Failed = ExecuteAssemblerImpl(Opts, Diags, DiagOS);
 
   // Delete output file if there were errors.
   if (Failed) {
@@ -581,11 +604,16 @@ static void LLVMErrorHandler(void *UserData, const char *Message,
   sys::Process::Exit(1);
 }
 
+static int cc1as_batch_main(ArrayRef<const char *> Argv);
+
 int cc1as_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
+  // myclang: -cc1as -batch <jobfile>
+  if (!Argv.empty() && StringRef(Argv[0]) == "-batch")
+    return cc1as_batch_main(Argv.slice(1));
+
   // Initialize targets and assembly printers/parsers.
-  InitializeAllTargetInfos();
-  InitializeAllTargetMCs();
-  InitializeAllAsmParsers();
+  // (myclang: only the target named by -triple)
+  MyclangInitializeTargets(Argv, MYCLANG_INIT_TARGET_MC | MYCLANG_INIT_ASM_PARSER);
 
   // Construct our diagnostic client.
   IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
@@ -602,8 +630,10 @@ int cc1as_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
 
   // Parse the arguments.
   AssemblerInvocation Asm;
+  uint64_t ParseStart = myclang_prof_now();
   if (!AssemblerInvocation::CreateFromArgs(Asm, Argv, Diags))
     return 1;
+  myclang_prof_add("option parsing", ParseStart);
 
   if (Asm.ShowHelp) {
     getDriverOptTable().printHelp(
@@ -645,3 +675,127 @@ int cc1as_main(ArrayRef<const char *> Argv, const char *Argv0, void *MainAddr) {
 
   return !!Failed;
 }
+
+// myclang: batch mode
+//
+//   -cc1as -batch <jobfile> [-j <N>]
+//
+// Assembles many files in one process, in parallel threads sharing one set of
+// initialized MC targets. Each line of <jobfile> describes one job:
+//
+//   <input> <output> [cc1as-option ...]
+//
+// which is equivalent to "-cc1as [cc1as-option ...] -o <output> <input>".
+// Lines are tokenized like GNU response files; empty lines and lines starting
+// with '#' are ignored. Inputs must be preprocessed assembly (i.e. .s, not .S.)
+// -j limits the number of threads (default: all hardware threads.)
+// Returns 1 if any job failed.
+static int cc1as_batch_main(ArrayRef<const char *> Argv) {
+  StringRef JobFile;
+  unsigned NumThreads = 0;
+  for (size_t i = 0; i < Argv.size(); i++) {
+    StringRef A(Argv[i]);
+    if (A == "-j" && i + 1 < Argv.size())
+      A = Argv[++i];
+    else if (!A.consume_front("-j")) {
+      if (!JobFile.empty()) {
+        errs() << "clang -cc1as: unexpected argument '" << A << "' in -batch mode\n";
+        return 1;
+      }
+      JobFile = A;
+      continue;
+    }
+    if (A.getAsInteger(10, NumThreads)) {
+      errs() << "clang -cc1as: invalid -j value '" << A << "'\n";
+      return 1;
+    }
+  }
+  if (JobFile.empty()) {
+    errs() << "clang -cc1as: -batch requires a job file\n";
+    return 1;
+  }
+
+  ErrorOr<std::unique_ptr<MemoryBuffer>> Buf =
+      MemoryBuffer::getFileOrSTDIN(JobFile);
+  if (!Buf) {
+    errs() << "clang -cc1as: " << JobFile << ": " << Buf.getError().message()
+           << "\n";
+    return 1;
+  }
+
+  // Parse the job file into cc1as argument lists
+  BumpPtrAllocator Alloc;
+  StringSaver Saver(Alloc);
+  std::vector<SmallVector<const char *, 16>> Jobs;
+  SmallVector<StringRef, 0> Lines;
+  (*Buf)->getBuffer().split(Lines, '\n', -1, false);
+  for (size_t LineNo = 0; LineNo < Lines.size(); LineNo++) {
+    StringRef Line = Lines[LineNo].trim();
+    if (Line.empty() || Line.startswith("#"))
+      continue;
+    SmallVector<const char *, 16> Toks;
+    cl::TokenizeGNUCommandLine(Line, Saver, Toks);
+    if (Toks.size() < 2) {
+      errs() << JobFile << ":" << LineNo + 1
+             << ": expected <input> <output> [option ...]\n";
+      return 1;
+    }
+    SmallVector<const char *, 16> Args(Toks.begin() + 2, Toks.end());
+    Args.push_back("-o");
+    Args.push_back(Toks[1]);
+    Args.push_back(Toks[0]);
+    Jobs.push_back(std::move(Args));
+  }
+
+  // Initialize the targets of all jobs up front, on this thread.
+  // (Target registration is not thread safe, but idempotent.)
+  for (const auto &Args : Jobs)
+    MyclangInitializeTargets(Args, MYCLANG_INIT_TARGET_MC | MYCLANG_INIT_ASM_PARSER);
+
+  // LLVM fatal errors exit the process, no matter what thread they occur on
+  IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+  TextDiagnosticPrinter *DiagClient
+    = new TextDiagnosticPrinter(errs(), &*DiagOpts);
+  DiagClient->setPrefix("clang -cc1as");
+  DiagnosticsEngine Diags(new DiagnosticIDs(), &*DiagOpts, DiagClient);
+  ScopedFatalErrorHandler FatalErrorHandler
+    (LLVMErrorHandler, static_cast<void*>(&Diags));
+
+  std::atomic<bool> Failed(false);
+  std::mutex ErrsMu;
+  ThreadPool Pool(hardware_concurrency(NumThreads));
+  for (const auto &Args : Jobs) {
+    Pool.async([&Args, &Failed, &ErrsMu] {
+      // Buffer option and assembler diagnostics so that each job's messages
+      // stay together
+      std::string DiagBuf;
+      raw_string_ostream DiagOS(DiagBuf);
+      IntrusiveRefCntPtr<DiagnosticOptions> DiagOpts = new DiagnosticOptions();
+      TextDiagnosticPrinter *DiagClient
+        = new TextDiagnosticPrinter(DiagOS, &*DiagOpts);
+      DiagClient->setPrefix("clang -cc1as");
+      DiagnosticsEngine Diags(new DiagnosticIDs(), &*DiagOpts, DiagClient);
+
+      AssemblerInvocation Asm;
+      bool JobFailed = !AssemblerInvocation::CreateFromArgs(Asm, Args, Diags);
+      // -mllvm sets process-global options, which can't vary per job
+      if (!JobFailed && !Asm.LLVMArgs.empty()) {
+        Diags.Report(diag::err_drv_unsupported_opt) << "-mllvm";
+        JobFailed = true;
+      }
+      JobFailed = JobFailed || Diags.hasErrorOccurred() ||
+                  ExecuteAssembler(Asm, Diags, &DiagOS);
+      if (JobFailed)
+        Failed = true;
+
+      DiagOS.flush();
+      if (!DiagBuf.empty()) {
+        std::lock_guard<std::mutex> Lock(ErrsMu);
+        errs() << DiagBuf;
+      }
+    });
+  }
+  Pool.wait();
+
+  return Failed ? 1 : 0;
+}
@@ -1,4 +1,13 @@
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/Triple.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/TargetSelect.h"
+#include <string>
+
+#include "myclang.h"
 
 extern "C" char* LLVMGetMainExecutable(const char* argv0) {
   // This just needs to be some symbol in the binary; C++ doesn't
@@ -6,3 +15,108 @@ extern "C" char* LLVMGetMainExecutable(const char* argv0) {
   void* P = (void*)(intptr_t)LLVMGetMainExecutable;
   return strdup(llvm::sys::fs::getMainExecutable(argv0, P).c_str());
 }
+
+// ———————————————————————————————————————————————————————————————————————————————————
+// lazy target initialization
+//
+// Instead of registering every target linked into myclang (llvm::InitializeAll*),
+// only the target(s) named on the command line are registered. We fall back to
+// registering all targets when the target can't be determined or when the
+// invocation lists targets or CPUs (e.g. --version, -print-targets, -mcpu=help.)
+
+using llvm::StringRef;
+
+// llvmTargetName returns the name LLVM registers a target under,
+// e.g. "X86" for "x86_64-linux-musl", or "" if unknown.
+static StringRef llvmTargetName(StringRef TripleStr) {
+  switch (llvm::Triple(TripleStr).getArch()) {
+    case llvm::Triple::x86:
+    case llvm::Triple::x86_64:      return "X86";
+    case llvm::Triple::arm:
+    case llvm::Triple::armeb:
+    case llvm::Triple::thumb:
+    case llvm::Triple::thumbeb:     return "ARM";
+    case llvm::Triple::aarch64:
+    case llvm::Triple::aarch64_be:
+    case llvm::Triple::aarch64_32:  return "AArch64";
+    case llvm::Triple::riscv32:
+    case llvm::Triple::riscv64:     return "RISCV";
+    case llvm::Triple::wasm32:
+    case llvm::Triple::wasm64:      return "WebAssembly";
+    default:                        return "";
+  }
+}
+
+// initTarget registers the named target. Returns false if the target is not
+// linked into myclang.
+static bool initTarget(StringRef Name, unsigned Components) {
+  bool Found = false;
+  #define LLVM_TARGET(T) \
+    if (Name == #T) { \
+      Found = true; \
+      LLVMInitialize##T##TargetInfo(); \
+      if (Components & MYCLANG_INIT_TARGET) LLVMInitialize##T##Target(); \
+      if (Components & MYCLANG_INIT_TARGET_MC) LLVMInitialize##T##TargetMC(); \
+    }
+  #include "llvm/Config/Targets.def"
+  if (!Found)
+    return false;
+  if (Components & MYCLANG_INIT_ASM_PRINTER) {
+    #define LLVM_ASM_PRINTER(T) if (Name == #T) LLVMInitialize##T##AsmPrinter();
+    #include "llvm/Config/AsmPrinters.def"
+  }
+  if (Components & MYCLANG_INIT_ASM_PARSER) {
+    #define LLVM_ASM_PARSER(T) if (Name == #T) LLVMInitialize##T##AsmParser();
+    #include "llvm/Config/AsmParsers.def"
+  }
+  return true;
+}
+
+static void initAllTargets(unsigned Components) {
+  llvm::InitializeAllTargetInfos();
+  if (Components & MYCLANG_INIT_TARGET)      llvm::InitializeAllTargets();
+  if (Components & MYCLANG_INIT_TARGET_MC)   llvm::InitializeAllTargetMCs();
+  if (Components & MYCLANG_INIT_ASM_PRINTER) llvm::InitializeAllAsmPrinters();
+  if (Components & MYCLANG_INIT_ASM_PARSER)  llvm::InitializeAllAsmParsers();
+}
+
+void MyclangInitializeTargets(llvm::ArrayRef<const char*> Args, unsigned Components) {
+  uint64_t T0 = myclang_prof_now();
+  llvm::SmallVector<std::string, 2> Triples;
+  bool All = false;
+
+  for (size_t i = 0; i < Args.size() && !All; i++) {
+    if (!Args[i]) // end-of-line response file marker
+      continue;
+    StringRef A(Args[i]);
+    StringRef Next = (i + 1 < Args.size() && Args[i + 1]) ? Args[i + 1] : "";
+    if (A == "-target" || A == "--target" || A == "-triple" || A == "-aux-triple") {
+      Triples.push_back(Next.str());
+      i++;
+    } else if (A.consume_front("--target=") || A.consume_front("-triple=")) {
+      Triples.push_back(A.str());
+    } else if (
+      A == "--version" || A == "-version" ||
+      A == "-print-targets" || A == "--print-targets" ||
+      A == "-print-supported-cpus" || A == "--print-supported-cpus" ||
+      A == "-mcpu=help" || A == "-mtune=help" || A == "-mcpu=?" ||
+      A == "-arch" || // darwin multi-arch
+      A.startswith("-fopenmp-targets=") || A.startswith("--offload-arch") )
+    {
+      All = true;
+    }
+  }
+  if (Triples.empty())
+    Triples.push_back(llvm::sys::getDefaultTargetTriple());
+
+  for (const std::string& T : Triples) {
+    if (All)
+      break;
+    StringRef Name = llvmTargetName(T);
+    All = Name.empty() || !initTarget(Name, Components);
+  }
+  if (All)
+    initAllTargets(Components);
+
+  myclang_prof_add("target init", T0);
+}
@@ -4,7 +4,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "clang/Basic/Version.inc" // CLANG_VERSION_STRING
+#include "myclang.h"
 
 static char* myclang;
 
@@ -41,6 +43,93 @@ static char* mkflag(
   return s;
 }
 
+static bool has_suffix(const char* s, const char* suffix) {
+  size_t len = strlen(s), suffixlen = strlen(suffix);
+  return len >= suffixlen && memcmp(s + len - suffixlen, suffix, suffixlen) == 0;
+}
+
+// module_flags sets flags to the arguments that make a C++ compilation use
+// the shared module cache and returns their count, or returns 0 if the cache
+// should not be used.
+//
+// With -fmodules clang builds libc++ (the sysroot's standard C++ headers) as
+// implicit modules once and reuses them. The module cache is keyed by a hash
+// of the target triple and the flags that affect the module (one subdirectory
+// per configuration) and clang coordinates concurrent builds of the same
+// module with lock files, so a single cache is shared by all invocations.
+//
+// This is opt-in since modules change what a translation unit sees: headers
+// reached only through another header's includes are not visible unless the
+// module exports them. Only libc++'s module map is loaded; implicit module
+// maps are disabled so that a project's own module.modulemap files are not
+// picked up. Preprocessing and syntax-only runs are left alone, as -E would
+// print "#pragma clang module import" instead of the header text.
+//
+// MYCLANG_MODULE_CACHE=DIR enables the cache in DIR and MYCLANG_MODULE_CACHE=1
+// in $XDG_CACHE_HOME/myclang/modules (~/.cache/myclang/modules.)
+static int module_flags(int argc, char* argv[], char* flags[4]) {
+  if (strcmp(argv[0], "clang++") != 0)
+    return 0;
+  const char* dir = getenv("MYCLANG_MODULE_CACHE");
+  if (!dir || !*dir || strcmp(dir, "0") == 0)
+    return 0;
+
+  bool compiles = false;
+  for (int i = 1; i < argc; i++) {
+    const char* a = argv[i];
+    // leave explicit module configuration alone, and don't use the cache
+    // when the sysroot's standard headers are not used
+    if (strncmp(a, "-fmodule", 8) == 0 || strncmp(a, "-fno-modules", 12) == 0 ||
+        strcmp(a, "-fcxx-modules") == 0 || strcmp(a, "-fno-cxx-modules") == 0 ||
+        strncmp(a, "-nostdinc", 9) == 0 || strcmp(a, "-nostdlibinc") == 0 ||
+        strcmp(a, "-fimplicit-module-maps") == 0)
+    {
+      return 0;
+    }
+    // only preprocess or check syntax
+    if (strcmp(a, "-E") == 0 || strcmp(a, "-M") == 0 || strcmp(a, "-MM") == 0 ||
+        strcmp(a, "-fsyntax-only") == 0)
+    {
+      return 0;
+    }
+    // only add module flags when compiling, to avoid "unused argument"
+    // warnings when linking
+    compiles |= strcmp(a, "-c") == 0 || strcmp(a, "-S") == 0 ||
+                (a[0] != '-' && (
+                  has_suffix(a, ".cc") || has_suffix(a, ".cpp") ||
+                  has_suffix(a, ".cxx") || has_suffix(a, ".c++") ||
+                  has_suffix(a, ".C") || has_suffix(a, ".mm") ));
+  }
+  if (!compiles)
+    return 0;
+
+  const char* modulemap = MYCLANG_SYSROOT "/include/c++/v1/module.modulemap";
+  if (access(modulemap, R_OK) != 0)
+    return 0;
+
+  // clang creates the cache directory (and its parents) on demand
+  char* cache;
+  if (strcmp(dir, "1") != 0) {
+    cache = mkflag("-fmodules-cache-path", '=', dir, NULL);
+  } else if ((dir = getenv("XDG_CACHE_HOME")) && *dir) {
+    cache = mkflag("-fmodules-cache-path", '=', dir, "/myclang/modules");
+  } else if ((dir = getenv("HOME")) && *dir) {
+    cache = mkflag("-fmodules-cache-path", '=', dir, "/.cache/myclang/modules");
+  } else {
+    return 0;
+  }
+  if (!cache)
+    return 0;
+
+  flags[0] = "-fmodules";
+  flags[1] = "-fno-implicit-module-maps";
+  flags[2] = mkflag("-fmodule-map-file", '=', modulemap, NULL);
+  flags[3] = cache;
+  if (!flags[2])
+    return 0;
+  return 4;
+}
+
 static int cc_main(int argc, char* argv[]) {
   char* i_include = mkflag("-isystem", 0, MYCLANG_SYSROOT, "/include");
   char* resource_dir = mkflag("-resource-dir", '=', MYCLANG_SYSROOT,
@@ -63,13 +152,17 @@ static int cc_main(int argc, char* argv[]) {
   };
   int ndefault_args = (int)(sizeof(default_args)/sizeof(default_args[0]));
 
-  int argc2 = ndefault_args + argc;
+  char* module_args[4];
+  int nmodule_args = module_flags(argc, argv, module_args);
+
+  int argc2 = ndefault_args + nmodule_args + argc;
   char** argv2 = (char**)malloc(sizeof(void*) * argc2);
   if (argv2 == NULL)
     return 2;
   argv2[0] = argv[0];
   memcpy(argv2 + 1, default_args, ndefault_args * sizeof(void*));
-  memcpy(argv2 + 1 + ndefault_args, argv+1, (argc-1) * sizeof(void*));
+  memcpy(argv2 + 1 + ndefault_args, module_args, nmodule_args * sizeof(void*));
+  memcpy(argv2 + 1 + ndefault_args + nmodule_args, argv+1, (argc-1) * sizeof(void*));
 
   // if -v is set, print invocation
   bool has_v = false;
@@ -85,6 +178,8 @@ static int cc_main(int argc, char* argv[]) {
 }
 
 int main(int argc, char* argv[]) {
+  myclang_prof_main();
+
   const char* progname = strrchr(argv[0], '/');
   progname = progname ? progname + 1 : argv[0];
   bool is_multicall = strcmp(progname, "myclang") != 0;
@@ -136,10 +231,15 @@ int main(int argc, char* argv[]) {
     "  cc        C compiler (clang)\n"
     "  c++       C++ compiler (clang++)\n"
     "  ar        Archiver (llvm-ar)\n"
+    "  as        Assembler (clang -cc1as; \"as -batch <jobfile>\" assembles many)\n"
     "  ld.lld    Mach-o linker\n"
     "  ld64.lld  ELF linker\n"
     "  lld-link  COFF linker\n"
     "  wasm-ld   WASM linker\n"
+    "environment:\n"
+    "  MYCLANG_STARTUP_PROFILE=1  Print startup-latency breakdown on exit\n"
+    "  MYCLANG_MODULE_CACHE=DIR   Use a shared C++ module cache in DIR\n"
+    "                             (1: ~/.cache/myclang/modules)\n"
   , progname);
   return 0;
 }
@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: Apache-2.0
+#pragma once
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// profile.c (see MYCLANG_STARTUP_PROFILE)
+uint64_t myclang_prof_now(void);
+void myclang_prof_add(const char* label, uint64_t start);
+void myclang_prof_main(void);
+
+#ifdef __cplusplus
+} // extern "C"
+
+#include "llvm/ADT/ArrayRef.h"
+
+// llvm-utils.cc
+// MyclangInitializeTargets registers the LLVM target(s) named by Args
+// (e.g. --target=T, -target T, -triple T) rather than all targets.
+enum : unsigned {
+  MYCLANG_INIT_TARGET       = 1u << 0, // LLVMInitialize*Target (implies TargetInfo)
+  MYCLANG_INIT_TARGET_MC    = 1u << 1,
+  MYCLANG_INIT_ASM_PRINTER  = 1u << 2,
+  MYCLANG_INIT_ASM_PARSER   = 1u << 3,
+};
+void MyclangInitializeTargets(llvm::ArrayRef<const char*> Args, unsigned Components);
+
+#endif // __cplusplus
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: Apache-2.0
+//
+// Startup-latency profile.
+// Enabled by setting MYCLANG_STARTUP_PROFILE in the environment, e.g.
+//   MYCLANG_STARTUP_PROFILE=1 myclang cc -c hello.c
+// A breakdown is printed to stderr when the process exits:
+//   time to main    CPU time spent by the process before main() was entered
+//                   (exec, dynamic loading, page faults and static ctors)
+//   static ctors    wall time from our first constructor to main()
+//   target init     wall time spent registering LLVM targets
+//   option parsing  wall time spent parsing driver, cc1 and cc1as options
+//   total           wall time from our first constructor to exit
+//
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROF_MAX_LABELS 8
+
+typedef struct {
+  const char* label;
+  uint64_t    ns;
+} profentry_t;
+
+static bool        prof_enabled;
+static uint64_t    prof_t0;          // time of our first constructor
+static uint64_t    prof_main_cpu;    // process CPU time at main()
+static profentry_t prof_entries[PROF_MAX_LABELS];
+static int         prof_nentries;
+
+static uint64_t nanotime(clockid_t clock) {
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) != 0)
+    return 0;
+  return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t myclang_prof_now(void) {
+  return prof_enabled ? nanotime(CLOCK_MONOTONIC) : 0;
+}
+
+// myclang_prof_add adds the time passed since start to the named bucket.
+// label must be a constant string. Repeated labels accumulate, so that
+// e.g. "target init" covers both the driver and an in-process cc1.
+void myclang_prof_add(const char* label, uint64_t start) {
+  if (!prof_enabled)
+    return;
+  uint64_t ns = nanotime(CLOCK_MONOTONIC) - start;
+  for (int i = 0; i < prof_nentries; i++) {
+    if (strcmp(prof_entries[i].label, label) == 0) {
+      prof_entries[i].ns += ns;
+      return;
+    }
+  }
+  if (prof_nentries < PROF_MAX_LABELS)
+    prof_entries[prof_nentries++] = (profentry_t){ label, ns };
+}
+
+static void prof_report(void) {
+  uint64_t total = nanotime(CLOCK_MONOTONIC) - prof_t0;
+  fprintf(stderr, "myclang startup profile (pid %d):\n", (int)getpid());
+  fprintf(stderr, "  %-16s %9.3f ms\n", "time to main", (double)prof_main_cpu / 1e6);
+  for (int i = 0; i < prof_nentries; i++) {
+    fprintf(stderr, "  %-16s %9.3f ms\n",
+      prof_entries[i].label, (double)prof_entries[i].ns / 1e6);
+  }
+  fprintf(stderr, "  %-16s %9.3f ms\n", "total", (double)total / 1e6);
+}
+
+// myclang_prof_main is called first thing in main()
+void myclang_prof_main(void) {
+  if (!prof_enabled)
+    return;
+  prof_main_cpu = nanotime(CLOCK_PROCESS_CPUTIME_ID);
+  myclang_prof_add("static ctors", prof_t0);
+  atexit(prof_report);
+}
+
+// Run before LLVM's and clang's static constructors (which use the default
+// priority) so that their cost shows up as "static ctors".
+// Note: Mach-O does not support constructor priorities; instead we rely on
+// myclang's own objects being linked before the LLVM libraries.
+#ifdef __APPLE__
+__attribute__((constructor))
+#else
+__attribute__((constructor(101)))
+#endif
+static void prof_init(void) {
+  const char* v = getenv("MYCLANG_STARTUP_PROFILE");
+  prof_enabled = v && *v && strcmp(v, "0") != 0;
+  if (prof_enabled)
+    prof_t0 = nanotime(CLOCK_MONOTONIC);
+}
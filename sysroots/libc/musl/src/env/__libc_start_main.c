@@ -15,6 +15,8 @@ extern weak hidden void (*const __init_array_start)(void), (*const __init_array_
 static void dummy1(void *p) {}
 weak_alias(dummy1, __init_ssp);
 
+weak_alias(dummy, __string_init_env);
+
 #define AUX_CNT 38
 
 #ifdef __GNUC__
@@ -40,7 +42,10 @@ void __init_libc(char **envp, char *pn)
 	__init_ssp((void *)aux[AT_RANDOM]);
 
 	if (aux[AT_UID]==aux[AT_EUID] && aux[AT_GID]==aux[AT_EGID]
-		&& !aux[AT_SECURE]) return;
+		&& !aux[AT_SECURE]) {
+		__string_init_env();
+		return;
+	}
 
 	struct pollfd pfd[3] = { {.fd=0}, {.fd=1}, {.fd=2} };
 	int r =
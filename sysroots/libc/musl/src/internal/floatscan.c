@@ -60,6 +60,57 @@ static long long scanexp(FILE *f, int pok)
 }
 
 
+static uint64_t mul64(uint64_t a, uint64_t b, uint64_t *lo)
+{
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 p = (unsigned __int128)a * b;
+	*lo = p;
+	return p>>64;
+#else
+	uint64_t al = a&0xffffffff, ah = a>>32, bl = b&0xffffffff, bh = b>>32;
+	uint64_t ll = al*bl, lh = al*bh, hl = ah*bl;
+	uint64_t mid = (ll>>32) + (uint32_t)lh + (uint32_t)hl;
+	*lo = mid<<32 | (uint32_t)ll;
+	return ah*bh + (lh>>32) + (hl>>32) + (mid>>32);
+#endif
+}
+
+/* Eisel-Lemire: w*10^q correctly rounded to a float or double, from
+ * the product of w and the first 64 or 128 bits of 10^q. The product
+ * is never above the exact value, by less than w units of its last
+ * bit; when that could change the rounding, or the result would not
+ * be a normal number, 0 is returned and the exact algorithm is used.
+ * Only for rounding to nearest. */
+static long double eisel_lemire(uint64_t w, int q, int bits, int emin, int emax)
+{
+	union { double f; uint64_t i; } u;
+	uint64_t hi, lo, yhi, ylo, m, mask = (1ULL<<62-bits)-1;
+	int lz, msb, e;
+
+	if (q < POW10_MIN || q > POW10_MAX) return 0;
+	lz = __builtin_clzll(w);
+	w <<= lz;
+	hi = mul64(w, __pow10_128[q-POW10_MIN][0], &lo);
+	if ((hi & mask) == mask && lo+w < w) {
+		yhi = mul64(w, __pow10_128[q-POW10_MIN][1], &ylo);
+		lo += yhi;
+		if (lo < yhi) hi++;
+		if ((hi & mask) == mask && lo+1 == 0 && ylo+w < w) return 0;
+	}
+
+	/* bits+1 bits, then round half to even */
+	msb = hi>>63;
+	m = hi >> msb+62-bits;
+	e = (217706*q >> 16) + 63 + msb - lz;
+	if (!lo && !(hi & mask) && (m&3) == 1) return 0;
+	m = (m + (m&1)) >> 1;
+	if (m>>bits) m >>= 1, e++;
+	if (e < emin+bits-1 || e >= emax) return 0;
+
+	u.i = (uint64_t)(e+1023)<<52 | m<<53-bits & (1ULL<<52)-1;
+	return u.f;
+}
+
 static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int pok)
 {
 	uint32_t x[KMAX];
@@ -76,6 +127,7 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 	long double y;
 	long double frac=0;
 	long double bias=0;
+	uint64_t w=0;
 	static const int p10s[] = { 10, 100, 1000, 10000,
 		100000, 1000000, 10000000, 100000000 };
 
@@ -98,6 +150,7 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 		} else if (k < KMAX-3) {
 			dc++;
 			if (c!='0') lnz = dc;
+			if (dc<=19) w = 10*w + c-'0';
 			if (j) x[k] = x[k]*10 + c-'0';
 			else x[k] = c-'0';
 			if (++j==9) {
@@ -151,6 +204,16 @@ static long double decfloat(FILE *f, int c, int bits, int emin, int sign, int po
 		return sign * LDBL_MIN * LDBL_MIN;
 	}
 
+	/* Up to 19 significant digits, to a float or double, rounding
+	 * to nearest: try the Eisel-Lemire fast path */
+	if (lnz<=19 && bits<=53) {
+		y = 2/LDBL_EPSILON;
+		if (y+0x0.8p0 == y && y+0x1.8p0 != y) {
+			y = eisel_lemire(w, lrp-(dc<19 ? dc : 19), bits, emin, emax);
+			if (y) return sign * y;
+		}
+	}
+
 	/* Align incomplete final B1B digit */
 	if (j) {
 		for (; j<9; j++) x[k]*=10;
@@ -2,7 +2,12 @@
 #define FLOATSCAN_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 hidden long double __floatscan(FILE *, int, int);
 
+#define POW10_MIN (-342)
+#define POW10_MAX 308
+extern hidden const uint64_t __pow10_128[POW10_MAX-POW10_MIN+1][2];
+
 #endif
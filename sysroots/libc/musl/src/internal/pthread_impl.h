@@ -58,6 +58,7 @@ struct pthread {
 	volatile int killlock[1];
 	char *dlerror_buf;
 	void *stdio_locks;
+	void *malloc_tcache;
 
 	/* Part 3 -- the positions of these fields relative to
 	 * the end of the structure is external and internal ABI. */
@@ -89,6 +90,7 @@ enum {
 #define _m_prev __u.__p[3]
 #define _m_next __u.__p[4]
 #define _m_count __u.__i[5]
+#define _m_spins __u.__i[5]
 #define _c_shared __u.__p[0]
 #define _c_seq __u.__vi[2]
 #define _c_waiters __u.__vi[3]
@@ -99,6 +101,8 @@ enum {
 #define _rw_lock __u.__vi[0]
 #define _rw_waiters __u.__vi[1]
 #define _rw_shared __u.__i[2]
+#define _rw_spins __u.__i[3]
+#define _rw_shards __u.__p[4]
 #define _b_lock __u.__vi[0]
 #define _b_waiters __u.__vi[1]
 #define _b_limit __u.__i[2]
@@ -149,6 +153,7 @@ hidden void __testcancel();
 hidden void __do_cleanup_push(struct __ptcb *);
 hidden void __do_cleanup_pop(struct __ptcb *);
 hidden void __pthread_tsd_run_dtors();
+hidden void __malloc_tcache_flush(void);
 
 hidden void __pthread_key_delete_synccall(void (*)(void *), void *);
 hidden int __pthread_key_delete_impl(pthread_key_t);
@@ -179,6 +184,27 @@ static inline void __futexwait(volatile void *addr, int val, int priv)
 	__syscall(SYS_futex, addr, FUTEX_WAIT, val, 0);
 }
 
+/* Adaptive spinning on contended locks (__spin_limit.c). A lock keeps
+ * the average number of a_spin() rounds after which waiters found it
+ * free; _m_spins shares its slot with _m_count, which NORMAL mutexes
+ * do not use. */
+#define SPIN_MAX 100
+hidden int __cpu_count(void);
+hidden int __spin_limit(int);
+static inline void __spin_update(volatile int *avg, int spins)
+{
+	int a = *avg, n = a + (spins - a) / 8;
+	if (n != a) *avg = n;
+}
+
+hidden int __pthread_rwlock_shard(pthread_rwlock_t *);
+hidden int __pthread_rwlock_sharded_destroy(pthread_rwlock_t *);
+hidden int __pthread_rwlock_sharded_tryrdlock(pthread_rwlock_t *);
+hidden int __pthread_rwlock_sharded_timedrdlock(pthread_rwlock_t *__restrict, const struct timespec *__restrict);
+hidden int __pthread_rwlock_sharded_trywrlock(pthread_rwlock_t *);
+hidden int __pthread_rwlock_sharded_timedwrlock(pthread_rwlock_t *__restrict, const struct timespec *__restrict);
+hidden int __pthread_rwlock_sharded_unlock(pthread_rwlock_t *);
+
 hidden void __acquire_ptc(void);
 hidden void __release_ptc(void);
 hidden void __inhibit_ptc(void);
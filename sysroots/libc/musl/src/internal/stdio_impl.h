@@ -3,11 +3,15 @@
 
 #include <stdio.h>
 #include "syscall.h"
+#include "libc.h"
 
 #define UNGET 8
 
+/* FILE locks are skipped until the first thread is created (lock < 0)
+ * and while the process is back to a single thread (!libc.need_locks);
+ * see __lockfile. */
 #define FFINALLOCK(f) ((f)->lock>=0 ? __lockfile((f)) : 0)
-#define FLOCK(f) int __need_unlock = ((f)->lock>=0 ? __lockfile((f)) : 0)
+#define FLOCK(f) int __need_unlock = ((f)->lock>=0 && libc.need_locks ? __lockfile((f)) : 0)
 #define FUNLOCK(f) do { if (__need_unlock) __unlockfile((f)); } while (0)
 
 #define F_PERM 1
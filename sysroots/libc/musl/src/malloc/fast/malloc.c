@@ -0,0 +1,526 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "libc.h"
+#include "lock.h"
+#include "atomic.h"
+#include "pthread_impl.h"
+
+/* Scalable malloc replacing mallocng, built as libmalloc-fast.a which
+ * is linked ahead of libc.a (clang-TARGET ... -lmalloc-fast). It defines
+ * the public malloc functions and their __libc_* counterparts used
+ * inside libc, so none of mallocng is linked.
+ *
+ * Each thread allocates from its own heap without locking. A heap owns
+ * segments: 4 MiB regions aligned to their size, so that the segment of
+ * a pointer is found by masking its address. A segment is made of 64 KiB
+ * pages; a span of one or more pages holds slots of one of 48 size
+ * classes (16 bytes to 128 KiB, four classes per power of two.) Larger
+ * allocations get a segment of their own ("huge").
+ *
+ * Slots freed by the owning thread go on their span's free list. Slots
+ * freed by other threads are pushed on the span's xfree list with CAS
+ * and taken back by the owner when it runs out of slots. Spans without
+ * free slots are unlisted from the heap: their xfree is set to FULL and
+ * the first remote free to such a span hands it back to the owner via
+ * the heap's xspans list.
+ *
+ * Segments are madvised MADV_HUGEPAGE and released whole: memory is
+ * returned to the system only when all pages of a segment are free, so
+ * transparent huge pages are not split by partial purges. A few free
+ * segments are kept (MADV_FREE'd) for reuse.
+ *
+ * Heaps of exited threads are adopted by new threads. */
+
+#define SEG_SHIFT 22
+#define SEG_SIZE ((size_t)1<<SEG_SHIFT)
+#define PG_SHIFT 16
+#define PG_SIZE ((size_t)1<<PG_SHIFT)
+#define SEG_PAGES (SEG_SIZE/PG_SIZE)
+#define SEG_CACHE_MAX 4
+#define HUGE_HDR 64
+
+#define NCLASSES 48
+#define SMALL_MAX (128*1024)
+#define SPAN_MIN_SLOTS 4
+
+#define FULL ((struct slot *)1)
+
+struct slot {
+	struct slot *next;
+};
+
+struct span {
+	struct slot *free;
+	struct slot *volatile xfree;
+	struct span *prev, *next;
+	struct span *xnext;
+	unsigned char *start;
+	uint32_t size, cap, bump, used;
+	uint8_t sc, npages, back, listed, aligned;
+};
+
+struct segment {
+	int huge;
+	size_t size;
+	struct heap *heap;
+	struct segment *next;
+	uint64_t freemap;
+	struct span spans[SEG_PAGES];
+};
+
+#define SEG_HDR ((sizeof(struct segment)+63) & -64)
+
+struct heap {
+	struct span *classes[NCLASSES];
+	struct segment *segs;
+	struct span *volatile xspans;
+	struct heap *next;
+};
+
+static volatile int lock[1];
+static struct heap *abandoned;
+static struct segment *seg_cache;
+static int seg_cache_cnt;
+
+static inline int size_to_class(size_t n)
+{
+	if (n <= 128) return n ? (n-1)>>4 : 0;
+	int b = 31 - a_clz_32(n-1);
+	return 8 + 4*(b-7) + ((n-1)>>(b-2) & 3);
+}
+
+static size_t class_size(int sc)
+{
+	if (sc < 8) return 16*(sc+1);
+	int b = 7 + (sc-8)/4;
+	return ((size_t)1<<b) + ((size_t)((sc-8)%4 + 1) << (b-2));
+}
+
+static inline struct segment *ptr_seg(const void *p)
+{
+	return (void *)((uintptr_t)p & -SEG_SIZE);
+}
+
+static inline struct span *ptr_span(struct segment *s, const void *p)
+{
+	struct span *sp = &s->spans[((uintptr_t)p & (SEG_SIZE-1)) >> PG_SHIFT];
+	return sp - sp->back;
+}
+
+static struct heap *heap_new(void)
+{
+	struct heap *h;
+	LOCK(lock);
+	if ((h = abandoned)) abandoned = h->next;
+	UNLOCK(lock);
+	if (!h) {
+		h = __mmap(0, sizeof *h, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (h == MAP_FAILED) return 0;
+	}
+	h->next = 0;
+	__pthread_self()->malloc_tcache = h;
+	return h;
+}
+
+static inline struct heap *get_heap(void)
+{
+	struct heap *h = __pthread_self()->malloc_tcache;
+	return h ? h : heap_new();
+}
+
+/* map size bytes aligned to SEG_SIZE */
+static void *seg_map(size_t size)
+{
+	size_t len = size + SEG_SIZE - PAGE_SIZE;
+	unsigned char *p = __mmap(0, len, PROT_READ|PROT_WRITE,
+		MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) return 0;
+	size_t pre = -(uintptr_t)p & (SEG_SIZE-1);
+	if (pre) __munmap(p, pre);
+	if (len-pre > size) __munmap(p+pre+size, len-pre-size);
+	p += pre;
+	if (size >= SEG_SIZE/2) __madvise(p, size, MADV_HUGEPAGE);
+	return p;
+}
+
+static struct segment *seg_new(struct heap *h)
+{
+	struct segment *s;
+	LOCK(lock);
+	if ((s = seg_cache)) {
+		seg_cache = s->next;
+		seg_cache_cnt--;
+	}
+	UNLOCK(lock);
+	if (!s && !(s = seg_map(SEG_SIZE))) return 0;
+	s->huge = 0;
+	s->size = SEG_SIZE;
+	s->heap = h;
+	s->freemap = -1;
+	s->next = h->segs;
+	h->segs = s;
+	return s;
+}
+
+static void seg_release(struct heap *h, struct segment *s)
+{
+	struct segment **pp = &h->segs;
+	while (*pp != s) pp = &(*pp)->next;
+	*pp = s->next;
+	__madvise(s, SEG_SIZE, MADV_FREE);
+	LOCK(lock);
+	if (seg_cache_cnt < SEG_CACHE_MAX) {
+		s->next = seg_cache;
+		seg_cache = s;
+		seg_cache_cnt++;
+		s = 0;
+	}
+	UNLOCK(lock);
+	if (s) __munmap(s, SEG_SIZE);
+}
+
+static int find_pages(uint64_t map, int n)
+{
+	if (n == 1) return map ? a_ctz_64(map) : -1;
+	uint64_t m = ((uint64_t)1<<n) - 1;
+	for (int i = 0; i + n <= SEG_PAGES; i++)
+		if ((map >> i & m) == m) return i;
+	return -1;
+}
+
+static void list_push(struct heap *h, struct span *sp)
+{
+	sp->prev = 0;
+	sp->next = h->classes[sp->sc];
+	if (sp->next) sp->next->prev = sp;
+	h->classes[sp->sc] = sp;
+	sp->listed = 1;
+}
+
+static void list_remove(struct heap *h, struct span *sp)
+{
+	if (sp->prev) sp->prev->next = sp->next;
+	else h->classes[sp->sc] = sp->next;
+	if (sp->next) sp->next->prev = sp->prev;
+	sp->listed = 0;
+}
+
+static struct span *span_new(struct heap *h, int sc)
+{
+	size_t size = class_size(sc);
+	int n = (SPAN_MIN_SLOTS*size + PG_SIZE-1) >> PG_SHIFT;
+	struct segment *s;
+	int i = -1;
+	for (s = h->segs; s; s = s->next)
+		if ((i = find_pages(s->freemap, n)) >= 0) break;
+	if (!s) {
+		if (!(s = seg_new(h))) return 0;
+		i = 0;
+	}
+	s->freemap &= ~((((uint64_t)1<<n) - 1) << i);
+	for (int j = 1; j < n; j++) s->spans[i+j].back = j;
+
+	struct span *sp = &s->spans[i];
+	unsigned char *base = (unsigned char *)s + ((size_t)i << PG_SHIFT);
+	sp->start = i ? base : (unsigned char *)s + SEG_HDR;
+	sp->size = size;
+	sp->cap = (base + ((size_t)n << PG_SHIFT) - sp->start) / size;
+	sp->bump = 0;
+	sp->used = 0;
+	sp->free = 0;
+	sp->xfree = 0;
+	sp->sc = sc;
+	sp->npages = n;
+	sp->back = 0;
+	sp->aligned = 0;
+	list_push(h, sp);
+	return sp;
+}
+
+static void span_release(struct heap *h, struct segment *s, struct span *sp)
+{
+	list_remove(h, sp);
+	s->freemap |= (((uint64_t)1<<sp->npages) - 1) << (sp - s->spans);
+	if (s->freemap == (uint64_t)-1 && (h->segs != s || s->next))
+		seg_release(h, s);
+}
+
+/* take slots freed by other threads */
+static void collect(struct span *sp)
+{
+	struct slot *x, *next;
+	do x = sp->xfree;
+	while (x && a_cas_p(&sp->xfree, x, 0) != x);
+	for (; x; x = next) {
+		next = x->next;
+		x->next = sp->free;
+		sp->free = x;
+		sp->used--;
+	}
+}
+
+/* relist spans handed back by other threads */
+static void drain(struct heap *h)
+{
+	struct span *sp, *next;
+	do sp = h->xspans;
+	while (sp && a_cas_p(&h->xspans, sp, 0) != sp);
+	for (; sp; sp = next) {
+		next = sp->xnext;
+		list_push(h, sp);
+	}
+}
+
+static void *alloc_slow(struct heap *h, int sc)
+{
+	struct span *sp, *next;
+	if (h->xspans) drain(h);
+	for (sp = h->classes[sc]; sp; sp = next) {
+		next = sp->next;
+		if (sp->xfree) collect(sp);
+		if (sp->free || sp->bump < sp->cap) break;
+		if (!a_cas_p(&sp->xfree, 0, FULL)) {
+			list_remove(h, sp);
+			continue;
+		}
+		collect(sp);
+		break;
+	}
+	if (!sp) {
+		if (!(sp = span_new(h, sc))) return 0;
+	} else if (sp != h->classes[sc]) {
+		list_remove(h, sp);
+		list_push(h, sp);
+	}
+	struct slot *p = sp->free;
+	if (p) sp->free = p->next;
+	else p = (struct slot *)(sp->start + sp->bump++ * sp->size);
+	sp->used++;
+	return p;
+}
+
+static inline void *alloc_small(struct heap *h, size_t n)
+{
+	int sc = size_to_class(n);
+	struct span *sp = h->classes[sc];
+	if (sp) {
+		struct slot *p = sp->free;
+		if (p) {
+			sp->free = p->next;
+			sp->used++;
+			return p;
+		}
+		if (sp->bump < sp->cap) {
+			sp->used++;
+			return sp->start + sp->bump++ * sp->size;
+		}
+	}
+	return alloc_slow(h, sc);
+}
+
+static void *alloc_huge(size_t n, size_t align)
+{
+	size_t off = align > HUGE_HDR ? align : HUGE_HDR;
+	size_t size = off + n + PAGE_SIZE-1 & -PAGE_SIZE;
+	struct segment *s = seg_map(size);
+	if (!s) return 0;
+	s->huge = 1;
+	s->size = size;
+	return (unsigned char *)s + off;
+}
+
+static void free_local(struct heap *h, struct segment *s, struct span *sp, struct slot *p)
+{
+	p->next = sp->free;
+	sp->free = p;
+	sp->used--;
+	if (!sp->listed && a_cas_p(&sp->xfree, FULL, 0) == FULL)
+		list_push(h, sp);
+	if (!sp->used && sp->listed && (sp->prev || sp->next))
+		span_release(h, s, sp);
+}
+
+static void free_remote(struct segment *s, struct span *sp, struct slot *p)
+{
+	struct slot *x;
+	do {
+		x = sp->xfree;
+		p->next = x == FULL ? 0 : x;
+	} while (a_cas_p(&sp->xfree, x, p) != x);
+	if (x == FULL) {
+		struct heap *h = s->heap;
+		struct span *y;
+		do {
+			y = h->xspans;
+			sp->xnext = y;
+		} while (a_cas_p(&h->xspans, y, sp) != y);
+	}
+}
+
+void *malloc(size_t n)
+{
+	void *p;
+	if (n <= SMALL_MAX) {
+		struct heap *h = get_heap();
+		p = h ? alloc_small(h, n) : 0;
+	} else {
+		p = n < PTRDIFF_MAX - SEG_SIZE ? alloc_huge(n, 0) : 0;
+	}
+	if (!p) errno = ENOMEM;
+	return p;
+}
+
+void free(void *p)
+{
+	if (!p) return;
+	struct segment *s = ptr_seg(p);
+	if (s->huge) {
+		__munmap(s, s->size);
+		return;
+	}
+	struct span *sp = ptr_span(s, p);
+	if (sp->aligned) {
+		size_t off = (unsigned char *)p - sp->start;
+		p = sp->start + off/sp->size*sp->size;
+	}
+	struct heap *h = __pthread_self()->malloc_tcache;
+	if (s->heap == h) free_local(h, s, sp, p);
+	else free_remote(s, sp, p);
+}
+
+size_t malloc_usable_size(void *p)
+{
+	if (!p) return 0;
+	struct segment *s = ptr_seg(p);
+	if (s->huge) return (unsigned char *)s + s->size - (unsigned char *)p;
+	struct span *sp = ptr_span(s, p);
+	if (!sp->aligned) return sp->size;
+	return sp->size - ((unsigned char *)p - sp->start) % sp->size;
+}
+
+void *calloc(size_t m, size_t n)
+{
+	if (n && m > (size_t)-1/n) {
+		errno = ENOMEM;
+		return 0;
+	}
+	n *= m;
+	void *p = malloc(n);
+	/* huge allocations are fresh mappings */
+	if (!p || n > SMALL_MAX) return p;
+	return memset(p, 0, n);
+}
+
+void *realloc(void *p, size_t n)
+{
+	if (!p) return malloc(n);
+	if (n >= PTRDIFF_MAX - SEG_SIZE) {
+		errno = ENOMEM;
+		return 0;
+	}
+	size_t avail = malloc_usable_size(p);
+	if (n <= avail && n >= avail/2) return p;
+
+	struct segment *s = ptr_seg(p);
+	if (s->huge && n > avail) {
+		size_t size = (unsigned char *)p - (unsigned char *)s + n + PAGE_SIZE-1 & -PAGE_SIZE;
+		if (__mremap(s, s->size, size, 0) != MAP_FAILED) {
+			s->size = size;
+			return p;
+		}
+	}
+	void *q = malloc(n);
+	if (!q) return 0;
+	memcpy(q, p, n < avail ? n : avail);
+	free(p);
+	return q;
+}
+
+void *aligned_alloc(size_t align, size_t n)
+{
+	if ((align & -align) != align) {
+		errno = EINVAL;
+		return 0;
+	}
+	if (align <= 16) return malloc(n);
+	if (align > SEG_SIZE/2 || n >= PTRDIFF_MAX - SEG_SIZE) {
+		errno = ENOMEM;
+		return 0;
+	}
+	/* slots are 16-byte aligned; pad so that the aligned pointer is
+	 * inside the slot even when n is 0 */
+	size_t len = (n ? n : 1) + align - 16;
+	unsigned char *p;
+	if (len > SMALL_MAX) {
+		p = alloc_huge(n, align);
+	} else {
+		struct heap *h = get_heap();
+		p = h ? alloc_small(h, len) : 0;
+		if (p && ((uintptr_t)p & (align-1))) {
+			ptr_span(ptr_seg(p), p)->aligned = 1;
+			p += -(uintptr_t)p & (align-1);
+		}
+	}
+	if (!p) errno = ENOMEM;
+	return p;
+}
+
+/* called by pthread_exit: give the thread's heap up for adoption */
+void __malloc_tcache_flush(void)
+{
+	pthread_t self = __pthread_self();
+	struct heap *h = self->malloc_tcache;
+	if (!h) return;
+	self->malloc_tcache = 0;
+	if (h->xspans) drain(h);
+	for (int sc = 0; sc < NCLASSES; sc++) {
+		struct span *sp, *next;
+		for (sp = h->classes[sc]; sp; sp = next) {
+			next = sp->next;
+			if (sp->xfree) collect(sp);
+			if (!sp->used) span_release(h, ptr_seg(sp), sp);
+		}
+	}
+	LOCK(lock);
+	h->next = abandoned;
+	abandoned = h;
+	UNLOCK(lock);
+}
+
+void __malloc_atfork(int who)
+{
+	if (who < 0) LOCK(lock);
+	else if (who > 0) lock[0] = 0;
+	else UNLOCK(lock);
+}
+
+void *__libc_malloc_impl(size_t n)
+{
+	return malloc(n);
+}
+
+void *__libc_malloc(size_t n)
+{
+	return malloc(n);
+}
+
+void *__libc_calloc(size_t m, size_t n)
+{
+	return calloc(m, n);
+}
+
+void *__libc_realloc(void *p, size_t n)
+{
+	return realloc(p, n);
+}
+
+void __libc_free(void *p)
+{
+	free(p);
+}
@@ -98,6 +98,47 @@ static struct mapinfo nontrivial_free(struct meta *g, int i)
 	return (struct mapinfo){ 0 };
 }
 
+static int no_tcache_put(struct meta *g, int idx)
+{
+	return 0;
+}
+
+weak_alias(no_tcache_put, __malloc_tcache_put);
+
+static void release_slot(struct meta *g, int idx)
+{
+	uint32_t self = 1u<<idx, all = (2u<<g->last_idx)-1;
+
+	// atomic free without locking if this is neither first or last slot
+	for (;;) {
+		uint32_t freed = g->freed_mask;
+		uint32_t avail = g->avail_mask;
+		uint32_t mask = freed | avail;
+		assert(!(mask&self));
+		if (!freed || mask+self==all) break;
+		if (!MT)
+			g->freed_mask = freed+self;
+		else if (a_cas(&g->freed_mask, freed, freed+self)!=freed)
+			continue;
+		return;
+	}
+
+	wrlock();
+	struct mapinfo mi = nontrivial_free(g, idx);
+	unlock();
+	if (mi.len) {
+		int e = errno;
+		munmap(mi.base, mi.len);
+		errno = e;
+	}
+}
+
+void __malloc_free_batch(const struct tcache_slot *slots, int cnt)
+{
+	for (int i=0; i<cnt; i++)
+		release_slot(slots[i].g, slots[i].idx);
+}
+
 void free(void *p)
 {
 	if (!p) return;
@@ -108,12 +149,15 @@ void free(void *p)
 	unsigned char *start = g->mem->storage + stride*idx;
 	unsigned char *end = start + stride - IB;
 	get_nominal_size(p, end);
-	uint32_t self = 1u<<idx, all = (2u<<g->last_idx)-1;
 	((unsigned char *)p)[-3] = 255;
 	// invalidate offset to group header, and cycle offset of
 	// used region within slot if current offset is zero.
 	*(uint16_t *)((char *)p-2) = 0;
 
+	// keep the slot in the thread's cache, if any
+	if (MT && g->sizeclass < TCACHE_CLASSES && __malloc_tcache_put(g, idx))
+		return;
+
 	// release any whole pages contained in the slot to be freed
 	// unless it's a single-slot group that will be unmapped.
 	if (((uintptr_t)(start-1) ^ (uintptr_t)end) >= 2*PGSZ && g->last_idx) {
@@ -126,26 +170,5 @@ void free(void *p)
 		}
 	}
 
-	// atomic free without locking if this is neither first or last slot
-	for (;;) {
-		uint32_t freed = g->freed_mask;
-		uint32_t avail = g->avail_mask;
-		uint32_t mask = freed | avail;
-		assert(!(mask&self));
-		if (!freed || mask+self==all) break;
-		if (!MT)
-			g->freed_mask = freed+self;
-		else if (a_cas(&g->freed_mask, freed, freed+self)!=freed)
-			continue;
-		return;
-	}
-
-	wrlock();
-	struct mapinfo mi = nontrivial_free(g, idx);
-	unlock();
-	if (mi.len) {
-		int e = errno;
-		munmap(mi.base, mi.len);
-		errno = e;
-	}
+	release_slot(g, idx);
 }
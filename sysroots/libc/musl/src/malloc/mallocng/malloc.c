@@ -296,6 +296,42 @@ static int alloc_slot(int sc, size_t req)
 	return 0;
 }
 
+static void *no_tcache_get(size_t n)
+{
+	return 0;
+}
+
+weak_alias(no_tcache_get, __malloc_tcache_get);
+
+// take up to cnt slots of size class sc for the thread cache: the
+// available slots of the active group, and if there are none, those
+// of the group alloc_slot activates.
+int __malloc_alloc_batch(int sc, size_t n, struct tcache_slot *slots, int cnt)
+{
+	int i = 0, grew = 0;
+	rdlock();
+	while (i < cnt) {
+		struct meta *g = ctx.active[sc];
+		uint32_t mask = g ? g->avail_mask : 0;
+		if (mask) {
+			for (; mask && i < cnt; i++) {
+				uint32_t first = mask&-mask;
+				mask -= first;
+				slots[i] = (struct tcache_slot){ g, a_ctz_32(first) };
+			}
+			g->avail_mask = mask;
+			continue;
+		}
+		if (grew++) break;
+		upgradelock();
+		int idx = alloc_slot(sc, n);
+		if (idx < 0) break;
+		slots[i++] = (struct tcache_slot){ ctx.active[sc], idx };
+	}
+	unlock();
+	return i;
+}
+
 void *malloc(size_t n)
 {
 	if (size_overflows(n)) return 0;
@@ -305,6 +341,11 @@ void *malloc(size_t n)
 	int idx;
 	int ctr;
 
+	if (MT && n < MMAP_THRESHOLD) {
+		void *p = __malloc_tcache_get(n);
+		if (p) return p;
+	}
+
 	if (n >= MMAP_THRESHOLD) {
 		size_t needed = n + IB + UNIT;
 		void *p = mmap(0, needed, PROT_READ|PROT_WRITE,
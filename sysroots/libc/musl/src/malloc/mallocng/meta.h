@@ -72,6 +72,28 @@ struct meta *alloc_meta(void);
 __attribute__((__visibility__("hidden")))
 int is_allzero(void *);
 
+/* Optional per-thread cache of slots (tcache.c). A cached slot is
+ * neither available nor freed as far as its group is concerned, and
+ * its in-band header is in the state free() leaves it in. */
+struct tcache_slot {
+	struct meta *g;
+	int idx;
+};
+
+#define TCACHE_CLASSES 24
+
+__attribute__((__visibility__("hidden")))
+int __malloc_alloc_batch(int, size_t, struct tcache_slot *, int);
+
+__attribute__((__visibility__("hidden")))
+void __malloc_free_batch(const struct tcache_slot *, int);
+
+__attribute__((__visibility__("hidden")))
+void *__malloc_tcache_get(size_t);
+
+__attribute__((__visibility__("hidden")))
+int __malloc_tcache_put(struct meta *, int);
+
 static inline void queue(struct meta **phead, struct meta *m)
 {
 	assert(!m->next);
@@ -0,0 +1,76 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "meta.h"
+#include "pthread_impl.h"
+
+/* Per-thread cache of free slots in front of the shared heap, for
+ * size classes below TCACHE_CLASSES (requests up to 2028 bytes).
+ * While the process is multithreaded, free() puts slots in the calling
+ * thread's cache and malloc() takes them from it without locking.
+ * Empty caches are refilled with TCACHE_BATCH slots taken under a
+ * single lock; full caches return their older half to the heap.
+ *
+ * The cache is not linked by default. Link with
+ *   -Wl,-u,__malloc_tcache_enable
+ * to use it. */
+
+#define TCACHE_CNT 32
+#define TCACHE_BATCH 16
+
+struct tcache {
+	int cnt[TCACHE_CLASSES];
+	struct tcache_slot slots[TCACHE_CLASSES][TCACHE_CNT];
+};
+
+const char __malloc_tcache_enable = 1;
+
+void *__malloc_tcache_get(size_t n)
+{
+	int sc = size_to_class(n);
+	if (sc >= TCACHE_CLASSES) return 0;
+
+	pthread_t self = __pthread_self();
+	struct tcache *tc = self->malloc_tcache;
+	if (!tc) {
+		tc = mmap(0, sizeof *tc, PROT_READ|PROT_WRITE,
+			MAP_PRIVATE|MAP_ANON, -1, 0);
+		if (tc == MAP_FAILED) return 0;
+		self->malloc_tcache = tc;
+	}
+
+	if (!tc->cnt[sc]) {
+		tc->cnt[sc] = __malloc_alloc_batch(sc, n,
+			tc->slots[sc], TCACHE_BATCH);
+		if (!tc->cnt[sc]) return 0;
+	}
+	struct tcache_slot s = tc->slots[sc][--tc->cnt[sc]];
+	return enframe(s.g, s.idx, n, ctx.mmap_counter);
+}
+
+int __malloc_tcache_put(struct meta *g, int idx)
+{
+	struct tcache *tc = __pthread_self()->malloc_tcache;
+	if (!tc) return 0;
+	int sc = g->sizeclass;
+	if (tc->cnt[sc] == TCACHE_CNT) {
+		int n = TCACHE_CNT/2;
+		__malloc_free_batch(tc->slots[sc], n);
+		memmove(tc->slots[sc], tc->slots[sc]+n, n*sizeof *tc->slots[sc]);
+		tc->cnt[sc] -= n;
+	}
+	tc->slots[sc][tc->cnt[sc]++] = (struct tcache_slot){ g, idx };
+	return 1;
+}
+
+void __malloc_tcache_flush(void)
+{
+	pthread_t self = __pthread_self();
+	struct tcache *tc = self->malloc_tcache;
+	if (!tc) return;
+	self->malloc_tcache = 0;
+	for (int sc=0; sc<TCACHE_CLASSES; sc++)
+		__malloc_free_batch(tc->slots[sc], tc->cnt[sc]);
+	munmap(tc, sizeof *tc);
+}
@@ -7,12 +7,14 @@ int __lockfile(FILE *f)
 	if ((owner & ~MAYBE_WAITERS) == tid)
 		return 0;
 	owner = a_cas(&f->lock, 0, tid);
-	if (!owner) return 1;
-	while ((owner = a_cas(&f->lock, 0, tid|MAYBE_WAITERS))) {
+	if (owner) while ((owner = a_cas(&f->lock, 0, tid|MAYBE_WAITERS))) {
 		if ((owner & MAYBE_WAITERS) ||
 		    a_cas(&f->lock, owner, owner|MAYBE_WAITERS)==owner)
 			__futexwait(&f->lock, owner|MAYBE_WAITERS, 1);
 	}
+	/* The other threads have exited. Like __lock, take this one
+	 * lock, which orders us after them, before skipping locks. */
+	if (libc.need_locks < 0) libc.need_locks = 0;
 	return 1;
 }
 
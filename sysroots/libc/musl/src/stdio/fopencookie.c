@@ -130,6 +130,8 @@ FILE *fopencookie(void *cookie, const char *mode, cookie_io_functions_t iofuncs)
 	f->f.seek = cookieseek;
 	f->f.close = cookieclose;
 
+	if (!libc.threaded) f->f.lock = -1;
+
 	/* Add new FILE to open file list */
 	return __ofl_add(&f->f);
 }
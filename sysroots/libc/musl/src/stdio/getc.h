@@ -7,6 +7,7 @@ __attribute__((__noinline__))
 static int locking_getc(FILE *f)
 {
 	if (a_cas(&f->lock, 0, MAYBE_WAITERS-1)) __lockfile(f);
+	else if (libc.need_locks < 0) libc.need_locks = 0;
 	int c = getc_unlocked(f);
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
 		__wake(&f->lock, 1, 1);
@@ -16,7 +17,8 @@ static int locking_getc(FILE *f)
 static inline int do_getc(FILE *f)
 {
 	int l = f->lock;
-	if (l < 0 || l && (l & ~MAYBE_WAITERS) == __pthread_self()->tid)
+	if (l < 0 || !libc.need_locks
+	    || l && (l & ~MAYBE_WAITERS) == __pthread_self()->tid)
 		return getc_unlocked(f);
 	return locking_getc(f);
 }
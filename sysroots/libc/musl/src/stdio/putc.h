@@ -7,6 +7,7 @@ __attribute__((__noinline__))
 static int locking_putc(int c, FILE *f)
 {
 	if (a_cas(&f->lock, 0, MAYBE_WAITERS-1)) __lockfile(f);
+	else if (libc.need_locks < 0) libc.need_locks = 0;
 	c = putc_unlocked(c, f);
 	if (a_swap(&f->lock, 0) & MAYBE_WAITERS)
 		__wake(&f->lock, 1, 1);
@@ -16,7 +17,8 @@ static int locking_putc(int c, FILE *f)
 static inline int do_putc(int c, FILE *f)
 {
 	int l = f->lock;
-	if (l < 0 || l && (l & ~MAYBE_WAITERS) == __pthread_self()->tid)
+	if (l < 0 || !libc.need_locks
+	    || l && (l & ~MAYBE_WAITERS) == __pthread_self()->tid)
 		return putc_unlocked(c, f);
 	return locking_putc(c, f);
 }
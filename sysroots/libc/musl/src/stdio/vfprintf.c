@@ -130,9 +130,19 @@ static void pop_arg(union arg *arg, int type, va_list *ap)
 	}
 }
 
+/* Most pieces fit in the buffer set up by vfprintf and are copied there
+ * directly; __fwritex is only needed to flush it, and to look for a
+ * newline when the stream is line buffered. */
+
 static void out(FILE *f, const char *s, size_t l)
 {
-	if (!(f->flags & F_ERR)) __fwritex((void *)s, l, f);
+	if (!l || (f->flags & F_ERR)) return;
+	if (l <= f->wend - f->wpos && (f->lbf < 0 || !memchr(s, '\n', l))) {
+		memcpy(f->wpos, s, l);
+		f->wpos += l;
+	} else {
+		__fwritex((void *)s, l, f);
+	}
 }
 
 static void pad(FILE *f, char c, int w, int l, int fl)
@@ -140,6 +150,11 @@ static void pad(FILE *f, char c, int w, int l, int fl)
 	char pad[256];
 	if (fl & (LEFT_ADJ | ZERO_PAD) || l >= w) return;
 	l = w - l;
+	if (l <= f->wend - f->wpos && !(f->flags & F_ERR)) {
+		memset(f->wpos, c, l);
+		f->wpos += l;
+		return;
+	}
 	memset(pad, c, l>sizeof pad ? sizeof pad : l);
 	for (; l >= sizeof pad; l -= sizeof pad)
 		out(f, pad, sizeof pad);
@@ -162,11 +177,22 @@ static char *fmt_o(uintmax_t x, char *s)
 	return s;
 }
 
+static const char digits2[200] = {
+	"00010203040506070809" "10111213141516171819"
+	"20212223242526272829" "30313233343536373839"
+	"40414243444546474849" "50515253545556575859"
+	"60616263646566676869" "70717273747576777879"
+	"80818283848586878889" "90919293949596979899"
+};
+
+/* Two digits per division */
 static char *fmt_u(uintmax_t x, char *s)
 {
 	unsigned long y;
-	for (   ; x>ULONG_MAX; x/=10) *--s = '0' + x%10;
-	for (y=x;           y; y/=10) *--s = '0' + y%10;
+	for (   ; x>ULONG_MAX; x/=100) memcpy(s-=2, digits2+2*(x%100), 2);
+	for (y=x;    y>=100; y/=100) memcpy(s-=2, digits2+2*(y%100), 2);
+	if (y>=10) memcpy(s-=2, digits2+2*y, 2);
+	else if (y) *--s = '0' + y;
 	return s;
 }
 
@@ -177,6 +203,146 @@ static char *fmt_u(uintmax_t x, char *s)
 typedef char compiler_defines_long_double_incorrectly[9-(int)sizeof(long double)];
 #endif
 
+#ifdef __SIZEOF_INT128__
+
+/* Fast path for %e, %f and %g: when the value scaled to the requested
+ * precision fits in 128 bits, it is rounded with one multiplication or
+ * division instead of being expanded in full, then stored as the base
+ * 10^9 limbs that the generic code produces. The result is the same,
+ * digit for digit; it is only used when rounding to nearest, because
+ * the generic code honors the current rounding mode. */
+
+typedef unsigned __int128 u128;
+
+static const uint64_t pow10_64[20] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000,
+	1000000000, 10000000000, 100000000000, 1000000000000,
+	10000000000000, 100000000000000, 1000000000000000,
+	10000000000000000, 100000000000000000, 1000000000000000000,
+	10000000000000000000U
+};
+
+static u128 pow10_128(int n)
+{
+	return n<20 ? pow10_64[n] : (u128)pow10_64[n-19]*pow10_64[19];
+}
+
+static int clz128(u128 x)
+{
+	return x>>64 ? __builtin_clzll(x>>64) : 64+__builtin_clzll(x);
+}
+
+/* m*2^e*10^s rounded to an integer, half to even; 0 if out of range */
+static int scale_round(uint64_t m, int e, int s, u128 *n)
+{
+	u128 x, d, q, rm;
+	if (s>38 || s<-38) return 0;
+	if (!m) {
+		*n = 0;
+		return 1;
+	}
+	if (s>=0) {
+		/* 10^s has at most s*1701/512+1 bits */
+		if ((s*1701>>9)+1 > 64+__builtin_clzll(m)) return 0;
+		x = m*pow10_128(s);
+		if (e>=0) {
+			if (e>=clz128(x)) return 0;
+			*n = x<<e;
+			return 1;
+		}
+		/* below 1/2 */
+		if (e<-128) {
+			*n = 0;
+			return 1;
+		}
+		if (e==-128) return 0;
+		q = x>>-e;
+		rm = x - (q<<-e);
+		d = (u128)1<<-e;
+	} else {
+		d = pow10_128(-s);
+		if (e>=0) {
+			if (e>=64+__builtin_clzll(m)) return 0;
+			x = (u128)m<<e;
+		} else {
+			if (-e>=clz128(d)) return 0;
+			x = m;
+			d <<= -e;
+		}
+		q = x/d;
+		rm = x%d;
+	}
+	*n = q + (rm>d-rm || rm==d-rm && (q&1));
+	return 1;
+}
+
+static int fmt_fp_fast(long double y, int e2, int p, int t, uint32_t *r, uint32_t **pa, uint32_t **pz)
+{
+	long double round = 2/LDBL_EPSILON;
+	uint64_t m, v;
+	u128 n;
+	uint32_t *a, *d, *z, mul, x;
+	int e, s, k, sig;
+
+	/* rounding to nearest? */
+	if (round+0x0.8p0 != round || round+0x1.8p0 == round) return 0;
+
+	/* y*2^e2 with y in [1,2) is m*2^e with m odd */
+	if (!y) {
+		m = 0;
+		e = 0;
+	} else {
+		if (y*0x1p63 != (m = y*0x1p63)) return 0;
+		k = __builtin_ctzll(m);
+		m >>= k;
+		e = e2-63+k;
+	}
+
+	if ((t|32)=='f') {
+		s = p;
+		if (!scale_round(m, e, s, &n)) return 0;
+	} else {
+		/* p significant digits, with the decimal exponent estimated
+		 * from the binary one and corrected upwards */
+		if (p>37 || e2<-1650 || e2>1650) return 0;
+		sig = (t|32)=='e' ? p+1 : p ? p : 1;
+		s = m ? sig-1 - (e2*78913 >> 18) : sig-1;
+		do if (!scale_round(m, e, s--, &n)) return 0;
+		while (n>=pow10_128(sig));
+		s++;
+	}
+
+	/* r[0] holds the units, r[1] the first nine decimals */
+	for (d=r-10; d<r+6; d++) *d=0;
+	if (s>0) {
+		k = (s+8)/9;
+		mul = pow10_64[9*k-s];
+	} else {
+		k = s/9;
+		mul = pow10_64[-s%9];
+	}
+	d = r+k;
+	z = d+1;
+	if (k<0) z = r+1;
+	x = 1000000000/mul;
+	for (; n>>64; x=1000000000, mul=1) *d-- = n%x*mul, n/=x;
+	for (v=n; v; x=1000000000, mul=1) *d-- = v%x*mul, v/=x;
+	for (a=d+1; a<z && !*a; a++);
+	if (a==z) a=z=r;
+	*pa = a;
+	*pz = z;
+	return 1;
+}
+
+#else
+
+static int fmt_fp_fast(long double y, int e2, int p, int t, uint32_t *r, uint32_t **pa, uint32_t **pz)
+{
+	return 0;
+}
+
+#endif
+
 static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 {
 	uint32_t big[(LDBL_MANT_DIG+28)/29 + 1          // mantissa expansion
@@ -265,6 +431,13 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 	}
 	if (p<0) p=6;
 
+	r = big+10;
+	if (fmt_fp_fast(y, e2, p, t, r, &a, &z)) {
+		if (a<z) for (i=10, e=9*(r-a); *a>=i; i*=10, e++);
+		else e=0;
+		goto rounded;
+	}
+
 	if (y) y *= 0x1p28, e2-=28;
 
 	if (e2<0) a=r=z=big;
@@ -340,6 +513,7 @@ static int fmt_fp(FILE *f, long double y, int w, int p, int fl, int t)
 		}
 		if (z>d+1) z=d+1;
 	}
+rounded:
 	for (; z>a && !z[-1]; z--);
 	
 	if ((t|32)=='g') {
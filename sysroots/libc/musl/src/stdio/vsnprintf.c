@@ -32,6 +32,15 @@ static size_t sn_write(FILE *f, const unsigned char *s, size_t l)
 	return l;
 }
 
+/* Used when s itself is the buffer: whatever does not fit is dropped */
+static size_t sn_write_direct(FILE *f, const unsigned char *s, size_t l)
+{
+	size_t k = MIN(l, f->wend - f->wpos);
+	memcpy(f->wpos, s, k);
+	f->wpos += k;
+	return l;
+}
+
 int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
 {
 	unsigned char buf[1];
@@ -44,6 +53,7 @@ int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
 		.buf = buf,
 		.cookie = &c,
 	};
+	int r;
 
 	if (n > INT_MAX) {
 		errno = EOVERFLOW;
@@ -51,5 +61,14 @@ int vsnprintf(char *restrict s, size_t n, const char *restrict fmt, va_list ap)
 	}
 
 	*c.s = 0;
-	return vfprintf(&f, fmt, ap);
+	if (n < 2) return vfprintf(&f, fmt, ap);
+
+	/* Format straight into s rather than through a buffer on the
+	 * stack of vfprintf */
+	f.write = sn_write_direct;
+	f.buf = (void *)s;
+	f.buf_size = MIN(n-1, UINTPTR_MAX-(uintptr_t)s);
+	r = vfprintf(&f, fmt, ap);
+	if (f.wpos) *f.wpos = 0;
+	return r;
 }
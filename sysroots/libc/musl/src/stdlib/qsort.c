@@ -1,221 +1,340 @@
-/* Copyright (C) 2011 by Valentin Ochs
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy
- * of this software and associated documentation files (the "Software"), to
- * deal in the Software without restriction, including without limitation the
- * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
- * sell copies of the Software, and to permit persons to whom the Software is
- * furnished to do so, subject to the following conditions:
- *
- * The above copyright notice and this permission notice shall be included in
- * all copies or substantial portions of the Software.
- *
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
- * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
- * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
- * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
- * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
- * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
- * IN THE SOFTWARE.
- */
-
-/* Minor changes by Rich Felker for integration in musl, 2011-04-27. */
-
-/* Smoothsort, an adaptive variant of Heapsort.  Memory usage: O(1).
-   Run time: Worst case O(n log n), close to O(n) in the mostly-sorted case. */
+/* Pattern-defeating quicksort, after Orson Peters' pdqsort, with the
+   branchless block partitioning of Edelkamp and Weiss' BlockQuicksort.
+   Memory usage: O(log n) stack. Run time: O(n log n) worst case, falling
+   back to heapsort after log2(n) badly unbalanced partitions; O(n) on
+   sorted, reverse sorted and many-duplicates inputs. Not stable. */
 
 #define _BSD_SOURCE
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "atomic.h"
-#define ntz(x) a_ctz_l((x))
-
 typedef int (*cmpfun)(const void *, const void *, void *);
 
-static inline int pntz(size_t p[2]) {
-	int r = ntz(p[0] - 1);
-	if(r != 0 || (r = 8*sizeof(size_t) + ntz(p[1])) != 8*sizeof(size_t)) {
-		return r;
+/* Partitions smaller than this are insertion sorted; partitions larger
+   than NINTHER use a pseudomedian of 9 as the pivot. */
+#define INSERTION 12
+#define NINTHER 128
+/* Number of element moves after which partial_insertion_sort gives up */
+#define PARTIAL_LIMIT 8
+/* Elements per block in partition_right; offsets must fit in a byte */
+#define BLOCK 64
+
+struct sorter {
+	size_t width;
+	int swaptype;
+	cmpfun cmp;
+	void *arg;
+};
+
+enum { SWAP_BYTES, SWAP_WORDS, SWAP_4, SWAP_8, SWAP_16 };
+
+#ifdef __GNUC__
+typedef uint32_t __attribute__((__may_alias__)) u32;
+typedef uint64_t __attribute__((__may_alias__)) u64;
+typedef size_t __attribute__((__may_alias__)) word;
+#endif
+
+/* swaptype is fixed for the whole sort, so the switch is well predicted and
+   4, 8 and 16 byte elements, the most common, are swapped with whole-word
+   loads and stores. */
+static inline void swap(const struct sorter *s, unsigned char *a, unsigned char *b)
+{
+	size_t n = s->width;
+#ifdef __GNUC__
+	switch (s->swaptype) {
+	case SWAP_4: {
+		uint32_t t = *(u32 *)a;
+		*(u32 *)a = *(u32 *)b;
+		*(u32 *)b = t;
+		return;
+	}
+	case SWAP_8: {
+		uint64_t t = *(u64 *)a;
+		*(u64 *)a = *(u64 *)b;
+		*(u64 *)b = t;
+		return;
+	}
+	case SWAP_16: {
+		uint64_t t0 = *(u64 *)a, t1 = *(u64 *)(a+8);
+		*(u64 *)a = *(u64 *)b;
+		*(u64 *)(a+8) = *(u64 *)(b+8);
+		*(u64 *)b = t0;
+		*(u64 *)(b+8) = t1;
+		return;
+	}
+	case SWAP_WORDS:
+		for (; n; n -= sizeof(size_t), a += sizeof(size_t), b += sizeof(size_t)) {
+			size_t t = *(word *)a;
+			*(word *)a = *(word *)b;
+			*(word *)b = t;
+		}
+		return;
+	}
+#endif
+	for (; n; n--, a++, b++) {
+		unsigned char t = *a;
+		*a = *b;
+		*b = t;
 	}
-	return 0;
 }
 
-static void cycle(size_t width, unsigned char* ar[], int n)
+static inline int compare(const struct sorter *s, const unsigned char *a, const unsigned char *b)
 {
-	unsigned char tmp[256];
-	size_t l;
-	int i;
+	return s->cmp(a, b, s->arg);
+}
 
-	if(n < 2) {
-		return;
-	}
+static void insertion_sort(const struct sorter *s, unsigned char *lo, unsigned char *hi)
+{
+	size_t w = s->width;
+	unsigned char *p, *q;
+	for (p = lo+w; p < hi; p += w)
+		for (q = p; q > lo && compare(s, q-w, q) > 0; q -= w)
+			swap(s, q-w, q);
+}
 
-	ar[n] = tmp;
-	while(width) {
-		l = sizeof(tmp) < width ? sizeof(tmp) : width;
-		memcpy(ar[n], ar[0], l);
-		for(i = 0; i < n; i++) {
-			memcpy(ar[i], ar[i + 1], l);
-			ar[i] += l;
+/* Insertion sorts [lo,hi) if that takes few moves; returns 0 and leaves
+   the range permuted but unsorted otherwise. */
+static int partial_insertion_sort(const struct sorter *s, unsigned char *lo, unsigned char *hi)
+{
+	size_t w = s->width, moves = 0;
+	unsigned char *p, *q;
+	for (p = lo+w; p < hi; p += w) {
+		for (q = p; q > lo && compare(s, q-w, q) > 0; q -= w) {
+			swap(s, q-w, q);
+			if (++moves > PARTIAL_LIMIT) return 0;
 		}
-		width -= l;
+	}
+	return 1;
+}
+
+static void sift_down(const struct sorter *s, unsigned char *base, size_t root, size_t n)
+{
+	size_t w = s->width, child;
+	while ((child = 2*root+1) < n) {
+		if (child+1 < n && compare(s, base+child*w, base+(child+1)*w) < 0)
+			child++;
+		if (compare(s, base+root*w, base+child*w) >= 0)
+			return;
+		swap(s, base+root*w, base+child*w);
+		root = child;
 	}
 }
 
-/* shl() and shr() need n > 0 */
-static inline void shl(size_t p[2], int n)
+static void heap_sort(const struct sorter *s, unsigned char *lo, unsigned char *hi)
 {
-	if(n >= 8 * sizeof(size_t)) {
-		n -= 8 * sizeof(size_t);
-		p[1] = p[0];
-		p[0] = 0;
+	size_t w = s->width, n = (hi-lo)/w, i;
+	for (i = n/2; i-- > 0; )
+		sift_down(s, lo, i, n);
+	for (i = n; --i > 0; ) {
+		swap(s, lo, lo+i*w);
+		sift_down(s, lo, 0, i);
 	}
-	p[1] <<= n;
-	p[1] |= p[0] >> (sizeof(size_t) * 8 - n);
-	p[0] <<= n;
 }
 
-static inline void shr(size_t p[2], int n)
+static inline void sort3(const struct sorter *s, unsigned char *a, unsigned char *b, unsigned char *c)
 {
-	if(n >= 8 * sizeof(size_t)) {
-		n -= 8 * sizeof(size_t);
-		p[0] = p[1];
-		p[1] = 0;
+	if (compare(s, b, a) < 0) swap(s, a, b);
+	if (compare(s, c, b) < 0) {
+		swap(s, b, c);
+		if (compare(s, b, a) < 0) swap(s, a, b);
 	}
-	p[0] >>= n;
-	p[0] |= p[1] << (sizeof(size_t) * 8 - n);
-	p[1] >>= n;
 }
 
-static void sift(unsigned char *head, size_t width, cmpfun cmp, void *arg, int pshift, size_t lp[])
+/* Partitions [lo,hi) around the pivot at lo into elements less than it,
+   then the pivot, then elements greater or equal. Returns the pivot's new
+   position and sets *already if no elements had to be moved. The elements
+   are classified a block at a time into arrays of offsets, with the result
+   of cmp added to a count instead of branched on, and only then swapped. */
+static unsigned char *partition_right(const struct sorter *s, unsigned char *lo, unsigned char *hi, int *already)
 {
-	unsigned char *rt, *lf;
-	unsigned char *ar[14 * sizeof(size_t) + 1];
-	int i = 1;
+	size_t w = s->width;
+	unsigned char *pivot = lo, *first = lo, *last = hi;
+	unsigned char offl[BLOCK], offr[BLOCK];
+	unsigned char *basel, *baser;
+	size_t numl = 0, numr = 0, startl = 0, startr = 0, i, n;
 
-	ar[0] = head;
-	while(pshift > 1) {
-		rt = head - width;
-		lf = head - width - lp[pshift - 2];
+	/* With a consistent cmp the median-of-3 would stop both scans, but
+	   qsort must stay within the array whatever cmp returns, so both are
+	   bounded. If they cross nothing needs to move. */
+	while ((first += w) < last && compare(s, first, pivot) < 0);
+	while (first < last && compare(s, last -= w, pivot) >= 0);
 
-		if(cmp(ar[0], lf, arg) >= 0 && cmp(ar[0], rt, arg) >= 0) {
-			break;
+	*already = first >= last;
+	if (!*already) {
+		swap(s, first, last);
+		first += w;
+		basel = first;
+		baser = last;
+		while (first < last) {
+			size_t unknown = (last-first)/w;
+			size_t lsplit = numl ? 0 : numr ? unknown : unknown/2;
+			size_t rsplit = numr ? 0 : unknown-lsplit;
+			if (lsplit > BLOCK) lsplit = BLOCK;
+			if (rsplit > BLOCK) rsplit = BLOCK;
+			for (i = 0; i < lsplit; i++, first += w) {
+				offl[numl] = i;
+				numl += compare(s, first, pivot) >= 0;
+			}
+			for (i = 0; i < rsplit; ) {
+				offr[numr] = ++i;
+				numr += compare(s, last -= w, pivot) < 0;
+			}
+			n = numl < numr ? numl : numr;
+			for (i = 0; i < n; i++)
+				swap(s, basel + offl[startl+i]*w, baser - offr[startr+i]*w);
+			numl -= n; numr -= n;
+			startl += n; startr += n;
+			if (!numl) {
+				startl = 0;
+				basel = first;
+			}
+			if (!numr) {
+				startr = 0;
+				baser = last;
+			}
 		}
-		if(cmp(lf, rt, arg) >= 0) {
-			ar[i++] = lf;
-			head = lf;
-			pshift -= 1;
-		} else {
-			ar[i++] = rt;
-			head = rt;
-			pshift -= 2;
+		/* At most one side has misplaced elements left; move them to
+		   the boundary. */
+		if (numl) {
+			while (numl--) swap(s, basel + offl[startl+numl]*w, last -= w);
+			first = last;
+		}
+		if (numr) {
+			while (numr--) {
+				swap(s, baser - offr[startr+numr]*w, first);
+				first += w;
+			}
 		}
 	}
-	cycle(width, ar, i);
+	swap(s, pivot, first-w);
+	return first-w;
 }
 
-static void trinkle(unsigned char *head, size_t width, cmpfun cmp, void *arg, size_t pp[2], int pshift, int trusty, size_t lp[])
+/* Partitions [lo,hi) around the pivot at lo into elements equal to it,
+   then elements greater. Used when the pivot equals the element before
+   lo, which is known to be no greater than any in [lo,hi), so that runs of
+   equal elements are removed in one pass. Returns the pivot's new
+   position, the last of the equal elements. */
+static unsigned char *partition_left(const struct sorter *s, unsigned char *lo, unsigned char *hi)
 {
-	unsigned char *stepson,
-	              *rt, *lf;
-	size_t p[2];
-	unsigned char *ar[14 * sizeof(size_t) + 1];
-	int i = 1;
-	int trail;
-
-	p[0] = pp[0];
-	p[1] = pp[1];
-
-	ar[0] = head;
-	while(p[0] != 1 || p[1] != 0) {
-		stepson = head - lp[pshift];
-		if(cmp(stepson, ar[0], arg) <= 0) {
-			break;
-		}
-		if(!trusty && pshift > 1) {
-			rt = head - width;
-			lf = head - width - lp[pshift - 2];
-			if(cmp(rt, stepson, arg) >= 0 || cmp(lf, stepson, arg) >= 0) {
-				break;
-			}
-		}
+	size_t w = s->width;
+	unsigned char *pivot = lo, *first = lo, *last = hi;
 
-		ar[i++] = stepson;
-		head = stepson;
-		trail = pntz(p);
-		shr(p, trail);
-		pshift += trail;
-		trusty = 0;
-	}
-	if(!trusty) {
-		cycle(width, ar, i);
-		sift(head, width, cmp, arg, pshift, lp);
+	/* The scans are bounded, like those of partition_right, so that an
+	   inconsistent cmp cannot take them outside [lo,hi). */
+	while (last > first && compare(s, pivot, last -= w) < 0);
+	while (first < last && compare(s, pivot, first += w) >= 0);
+
+	while (first < last) {
+		swap(s, first, last);
+		while (last > first && compare(s, pivot, last -= w) < 0);
+		while (first < last && compare(s, pivot, first += w) >= 0);
 	}
+	swap(s, pivot, last);
+	return last;
 }
 
-void __qsort_r(void *base, size_t nel, size_t width, cmpfun cmp, void *arg)
+static void sort(const struct sorter *s, unsigned char *lo, unsigned char *hi, int bad, int leftmost)
 {
-	size_t lp[12*sizeof(size_t)];
-	size_t i, size = width * nel;
-	unsigned char *head, *high;
-	size_t p[2] = {1, 0};
-	int pshift = 1;
-	int trail;
-
-	if (!size) return;
-
-	head = base;
-	high = head + size - width;
-
-	/* Precompute Leonardo numbers, scaled by element width */
-	for(lp[0]=lp[1]=width, i=2; (lp[i]=lp[i-2]+lp[i-1]+width) < size; i++);
-
-	while(head < high) {
-		if((p[0] & 3) == 3) {
-			sift(head, width, cmp, arg, pshift, lp);
-			shr(p, 2);
-			pshift += 2;
+	size_t w = s->width;
+
+	for (;;) {
+		size_t n = (hi-lo)/w, half = n/2, nl, nr;
+		unsigned char *mid = lo + half*w, *p;
+		int already;
+
+		if (n < INSERTION) {
+			insertion_sort(s, lo, hi);
+			return;
+		}
+
+		/* Move the median of 3, or pseudomedian of 9, to lo. Either way
+		   the ends now hold elements no less and no greater than it. */
+		if (n > NINTHER) {
+			sort3(s, lo, mid, hi-w);
+			sort3(s, lo+w, mid-w, hi-2*w);
+			sort3(s, lo+2*w, mid+w, hi-3*w);
+			sort3(s, mid-w, mid, mid+w);
+			swap(s, lo, mid);
 		} else {
-			if(lp[pshift - 1] >= high - head) {
-				trinkle(head, width, cmp, arg, p, pshift, 0, lp);
-			} else {
-				sift(head, width, cmp, arg, pshift, lp);
-			}
+			sort3(s, mid, lo, hi-w);
+		}
 
-			if(pshift == 1) {
-				shl(p, 1);
-				pshift = 0;
-			} else {
-				shl(p, pshift - 1);
-				pshift = 1;
-			}
+		/* A pivot equal to the previous one means that there is no
+		   element less than it here; skip all that are equal. */
+		if (!leftmost && compare(s, lo-w, lo) >= 0) {
+			lo = partition_left(s, lo, hi) + w;
+			continue;
 		}
 
-		p[0] |= 1;
-		head += width;
-	}
+		p = partition_right(s, lo, hi, &already);
+		nl = (p-lo)/w;
+		nr = (hi-p)/w - 1;
 
-	trinkle(head, width, cmp, arg, p, pshift, 0, lp);
+		if (nl < n/8 || nr < n/8) {
+			/* Badly unbalanced. After too many of these, switch to
+			   heapsort; until then, swap some elements around to break
+			   up the pattern that caused it. */
+			if (!--bad) {
+				heap_sort(s, lo, hi);
+				return;
+			}
+			if (nl >= INSERTION) {
+				swap(s, lo, lo + nl/4*w);
+				swap(s, p-w, p - nl/4*w);
+				if (nl > NINTHER) {
+					swap(s, lo+w, lo + (nl/4+1)*w);
+					swap(s, lo+2*w, lo + (nl/4+2)*w);
+					swap(s, p-2*w, p - (nl/4+1)*w);
+					swap(s, p-3*w, p - (nl/4+2)*w);
+				}
+			}
+			if (nr >= INSERTION) {
+				swap(s, p+w, p + (1+nr/4)*w);
+				swap(s, hi-w, hi - nr/4*w);
+				if (nr > NINTHER) {
+					swap(s, p+2*w, p + (2+nr/4)*w);
+					swap(s, p+3*w, p + (3+nr/4)*w);
+					swap(s, hi-2*w, hi - (1+nr/4)*w);
+					swap(s, hi-3*w, hi - (2+nr/4)*w);
+				}
+			}
+		} else if (already && partial_insertion_sort(s, lo, p)
+		           && partial_insertion_sort(s, p+w, hi)) {
+			/* The input was likely sorted already */
+			return;
+		}
 
-	while(pshift != 1 || p[0] != 1 || p[1] != 0) {
-		if(pshift <= 1) {
-			trail = pntz(p);
-			shr(p, trail);
-			pshift += trail;
+		/* Recurse into the smaller side to bound the stack depth */
+		if (nl < nr) {
+			sort(s, lo, p, bad, leftmost);
+			lo = p+w;
+			leftmost = 0;
 		} else {
-			shl(p, 2);
-			pshift -= 2;
-			p[0] ^= 7;
-			shr(p, 1);
-			trinkle(head - lp[pshift] - width, width, cmp, arg, p, pshift + 1, 1, lp);
-			shl(p, 1);
-			p[0] |= 1;
-			trinkle(head - width, width, cmp, arg, p, pshift, 1, lp);
+			sort(s, p+w, hi, bad, 0);
+			hi = p;
 		}
-		head -= width;
 	}
 }
 
+void __qsort_r(void *base, size_t nel, size_t width, cmpfun cmp, void *arg)
+{
+	struct sorter s = { width, SWAP_BYTES, cmp, arg };
+	uintptr_t a = (uintptr_t)base;
+	int bad = 0;
+
+	if (nel < 2 || !width) return;
+
+	if (width == 4 && a % 4 == 0) s.swaptype = SWAP_4;
+	else if (width == 8 && a % 8 == 0) s.swaptype = SWAP_8;
+	else if (width == 16 && a % 8 == 0) s.swaptype = SWAP_16;
+	else if ((a | width) % sizeof(size_t) == 0) s.swaptype = SWAP_WORDS;
+
+	/* log2(nel) badly unbalanced partitions are allowed */
+	for (; nel >> bad; bad++);
+
+	sort(&s, base, (unsigned char *)base + nel*width, bad, 1);
+}
+
 weak_alias(__qsort_r, qsort_r);
@@ -0,0 +1,24 @@
+#include <string.h>
+#include "neon.h"
+
+void *memchr(const void *src, int c, size_t n)
+{
+	const unsigned char *s = src;
+	const unsigned char *p = (const void *)((uintptr_t)s & -16);
+	size_t k = (uintptr_t)s & 15;
+	v16 kc = dup(c);
+	uint64_t m;
+
+	if (!n) return 0;
+	/* first, aligned block; bytes before s are shifted out */
+	m = eq(p, kc) >> 4*k;
+	if (n < 16-k) m &= first(n);
+	if (m) return (void *)(s + (a_ctz_64(m) >> 2));
+	if (n <= 16-k) return 0;
+	n -= 16-k;
+	for (p += 16; n > 16; p += 16, n -= 16)
+		if ((m = eq(p, kc))) return (void *)(p + (a_ctz_64(m) >> 2));
+	m = eq(p, kc);
+	if (n < 16) m &= first(n);
+	return m ? (void *)(p + (a_ctz_64(m) >> 2)) : 0;
+}
@@ -0,0 +1,32 @@
+#include <string.h>
+#include "neon.h"
+
+int memcmp(const void *vl, const void *vr, size_t n)
+{
+	const unsigned char *l=vl, *r=vr;
+	uint64_t m;
+	size_t i;
+
+	if (n >= 16) {
+		for (; n >= 16; n -= 16, l += 16, r += 16)
+			if ((m = ne(l, r))) goto found;
+		if (!n) return 0;
+		/* last block overlaps the one already compared */
+		l -= 16-n; r -= 16-n;
+		if ((m = ne(l, r) >> 4*(16-n))) {
+			l += 16-n; r += 16-n;
+			goto found;
+		}
+		return 0;
+	}
+	if (n && PAGE_SAFE(l) && PAGE_SAFE(r)) {
+		m = ne(l, r) & first(n);
+		if (m) goto found;
+		return 0;
+	}
+	for (; n && *l == *r; n--, l++, r++);
+	return n ? *l-*r : 0;
+found:
+	i = a_ctz_64(m) >> 2;
+	return l[i]-r[i];
+}
@@ -0,0 +1,78 @@
+#ifndef NEON_H
+#define NEON_H
+
+#include <stdint.h>
+#include <features.h>
+#include "atomic.h"
+
+/* Advanced SIMD helpers for the aarch64 string functions.
+ *
+ * A 16-byte block is compared into a vector of 0x00/0xff bytes, which
+ * SHRN #4 narrows to a 64-bit mask with 4 bits per byte: byte i of the
+ * block is nibble i of the mask, so a_ctz_64(m)/4 is the index of the
+ * first match. This is written with vector extensions rather than
+ * arm_neon.h, which is not available under -nostdinc; clang turns the
+ * shift and truncation below into a single shrn.
+ *
+ * Blocks are read whole, so callers must make sure a block does not
+ * cross into a page that the string does not reach: either by reading
+ * aligned blocks or by checking the page offset first. 4096 is the
+ * smallest page size. */
+
+#define PAGE_SAFE(p) (((uintptr_t)(p) & 4095) <= 4096-16)
+
+typedef unsigned char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef unsigned char v16u __attribute__((__vector_size__(16), __may_alias__, __aligned__(1)));
+typedef uint16_t v8h __attribute__((__vector_size__(16)));
+typedef unsigned char v8b __attribute__((__vector_size__(8)));
+
+#define NEON_INLINE static inline __attribute__((__always_inline__))
+
+NEON_INLINE v16 load(const unsigned char *p)
+{
+	return *(const v16u *)p;
+}
+
+NEON_INLINE v16 dup(int c)
+{
+	return (v16){0} + (unsigned char)c;
+}
+
+NEON_INLINE uint64_t mask(v16 cmp)
+{
+	return (uint64_t)__builtin_convertvector((v8h)cmp >> 4, v8b);
+}
+
+/* nibble mask of the first n < 16 bytes */
+NEON_INLINE uint64_t first(size_t n)
+{
+	return ((uint64_t)1 << 4*n) - 1;
+}
+
+/* bytes equal to c */
+NEON_INLINE uint64_t eq(const unsigned char *p, v16 c)
+{
+	return mask((v16)(load(p) == c));
+}
+
+/* bytes equal to c or zero */
+NEON_INLINE uint64_t eqz(const unsigned char *p, v16 c)
+{
+	v16 a = load(p);
+	return mask((v16)((a == c) | (a == 0)));
+}
+
+/* bytes that differ */
+NEON_INLINE uint64_t ne(const unsigned char *p, const unsigned char *q)
+{
+	return mask((v16)(load(p) != load(q)));
+}
+
+/* bytes that differ or are zero in p */
+NEON_INLINE uint64_t nez(const unsigned char *p, const unsigned char *q)
+{
+	v16 a = load(p);
+	return mask((v16)((a != load(q)) | (a == 0)));
+}
+
+#endif
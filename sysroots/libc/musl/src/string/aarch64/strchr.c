@@ -0,0 +1,13 @@
+#include <string.h>
+#include "neon.h"
+
+char *strchr(const char *s, int c)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -16);
+	v16 k = dup(c);
+	uint64_t m = eqz(p, k) >> 4*((uintptr_t)s & 15);
+	if (m) p = (const void *)s;
+	else do p += 16; while (!(m = eqz(p, k)));
+	p += a_ctz_64(m) >> 2;
+	return *p == (unsigned char)c ? (char *)p : 0;
+}
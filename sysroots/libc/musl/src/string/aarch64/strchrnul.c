@@ -0,0 +1,19 @@
+#include <string.h>
+#include "neon.h"
+
+char *__strchrnul(const char *s, int c)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -16);
+	v16 k = dup(c);
+	uint64_t m = eqz(p, k) >> 4*((uintptr_t)s & 15);
+	if (m) return (char *)s + (a_ctz_64(m) >> 2);
+	for (;;) {
+		p += 16;
+		if ((m = eqz(p, k))) break;
+		p += 16;
+		if ((m = eqz(p, k))) break;
+	}
+	return (char *)p + (a_ctz_64(m) >> 2);
+}
+
+weak_alias(__strchrnul, strchrnul);
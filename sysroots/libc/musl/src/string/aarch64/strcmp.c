@@ -0,0 +1,27 @@
+#include <string.h>
+#include "neon.h"
+
+int strcmp(const char *sl, const char *sr)
+{
+	const unsigned char *l = (const void *)sl, *r = (const void *)sr;
+	uint64_t m;
+	size_t i, k, kr;
+
+	for (;;) {
+		if (PAGE_SAFE(l) && PAGE_SAFE(r)) {
+			if ((m = nez(l, r))) break;
+			l += 16; r += 16;
+			continue;
+		}
+		/* a block would cross into the next page: compare bytewise
+		 * up to the page end nearest to l or r */
+		k = 4096 - ((uintptr_t)l & 4095);
+		kr = 4096 - ((uintptr_t)r & 4095);
+		if (kr < k) k = kr;
+		for (i = 0; i < k; i++)
+			if (l[i] != r[i] || !l[i]) return l[i]-r[i];
+		l += k; r += k;
+	}
+	i = a_ctz_64(m) >> 2;
+	return l[i]-r[i];
+}
@@ -0,0 +1,17 @@
+#include <string.h>
+#include "neon.h"
+
+size_t strlen(const char *s)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -16);
+	v16 z = dup(0);
+	uint64_t m = eq(p, z) >> 4*((uintptr_t)s & 15);
+	if (m) return a_ctz_64(m) >> 2;
+	for (;;) {
+		p += 16;
+		if ((m = eq(p, z))) break;
+		p += 16;
+		if ((m = eq(p, z))) break;
+	}
+	return p + (a_ctz_64(m) >> 2) - (const unsigned char *)s;
+}
@@ -0,0 +1,32 @@
+#include <string.h>
+#include "neon.h"
+
+int strncmp(const char *sl, const char *sr, size_t n)
+{
+	const unsigned char *l = (const void *)sl, *r = (const void *)sr;
+	uint64_t m;
+	size_t i, k, kr;
+
+	while (n) {
+		if (PAGE_SAFE(l) && PAGE_SAFE(r)) {
+			m = nez(l, r);
+			if (n < 16) m &= first(n);
+			if (m) goto found;
+			if (n <= 16) return 0;
+			l += 16; r += 16; n -= 16;
+			continue;
+		}
+		/* compare bytewise up to the nearest page end */
+		k = 4096 - ((uintptr_t)l & 4095);
+		kr = 4096 - ((uintptr_t)r & 4095);
+		if (kr < k) k = kr;
+		if (n < k) k = n;
+		for (i = 0; i < k; i++)
+			if (l[i] != r[i] || !l[i]) return l[i]-r[i];
+		l += k; r += k; n -= k;
+	}
+	return 0;
+found:
+	i = a_ctz_64(m) >> 2;
+	return l[i]-r[i];
+}
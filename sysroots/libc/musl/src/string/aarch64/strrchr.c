@@ -0,0 +1,25 @@
+#include <string.h>
+#include "neon.h"
+
+char *strrchr(const char *s, int c)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -16), *last = 0;
+	size_t k = (uintptr_t)s & 15;
+	v16 kc = dup(c), a;
+	uint64_t m, z, lastm = 0;
+
+	if (!(unsigned char)c) return (char *)s + strlen(s);
+	for (;; p += 16, k = 0) {
+		a = load(p);
+		m = mask((v16)(a == kc)) >> 4*k << 4*k;
+		z = mask((v16)(a == 0)) >> 4*k << 4*k;
+		if (z) {
+			/* only matches before the terminator count */
+			m &= (z & -z) - 1;
+			if (m) last = p, lastm = m;
+			break;
+		}
+		if (m) last = p, lastm = m;
+	}
+	return last ? (char *)last + ((63 - a_clz_64(lastm)) >> 2) : 0;
+}
@@ -0,0 +1,54 @@
+#include <string.h>
+#include "simd.h"
+
+SIMD_INLINE void *memchr_simd(const void *src, int c, size_t n, simd_eq_fn eq)
+{
+	const unsigned char *s = src;
+	const unsigned char *p = (const void *)((uintptr_t)s & -64);
+	size_t k = (uintptr_t)s & 63;
+	uint64_t m;
+
+	if (!n) return 0;
+	/* first, aligned block; bytes before s are shifted out */
+	m = eq(p, c) >> k;
+	if (n < 64-k) m &= ((uint64_t)1 << n) - 1;
+	if (m) return (void *)(s + a_ctz_64(m));
+	if (n <= 64-k) return 0;
+	n -= 64-k;
+	for (p += 64; n > 64; p += 64, n -= 64)
+		if ((m = eq(p, c))) return (void *)(p + a_ctz_64(m));
+	m = eq(p, c);
+	if (n < 64) m &= ((uint64_t)1 << n) - 1;
+	return m ? (void *)(p + a_ctz_64(m)) : 0;
+}
+
+static void *memchr_sse2(const void *s, int c, size_t n)
+{
+	return memchr_simd(s, c, n, sse2_eq);
+}
+
+static TARGET_AVX2 void *memchr_avx2(const void *s, int c, size_t n)
+{
+	return memchr_simd(s, c, n, avx2_eq);
+}
+
+static TARGET_AVX512 void *memchr_avx512(const void *s, int c, size_t n)
+{
+	return memchr_simd(s, c, n, avx512_eq);
+}
+
+static void *memchr_init(const void *, int, size_t);
+static void *(*impl)(const void *, int, size_t) = memchr_init;
+
+static void *memchr_init(const void *s, int c, size_t n)
+{
+	static void *(*const impls[])(const void *, int, size_t) = {
+		memchr_sse2, memchr_avx2, memchr_avx512 };
+	impl = impls[__string_simd_level()];
+	return impl(s, c, n);
+}
+
+void *memchr(const void *s, int c, size_t n)
+{
+	return impl(s, c, n);
+}
@@ -0,0 +1,63 @@
+#include <string.h>
+#include "simd.h"
+
+SIMD_INLINE int memcmp_simd(const void *vl, const void *vr, size_t n, simd_ne_fn ne)
+{
+	const unsigned char *l=vl, *r=vr;
+	uint64_t m;
+	size_t i;
+
+	if (n >= 64) {
+		for (; n >= 64; n -= 64, l += 64, r += 64)
+			if ((m = ne(l, r))) goto found;
+		if (!n) return 0;
+		/* last block overlaps the one already compared */
+		l -= 64-n; r -= 64-n;
+		if ((m = ne(l, r) >> (64-n))) {
+			l += 64-n; r += 64-n;
+			goto found;
+		}
+		return 0;
+	}
+	if (n && PAGE_SAFE(l) && PAGE_SAFE(r)) {
+		m = ne(l, r) & (((uint64_t)1 << n) - 1);
+		if (m) goto found;
+		return 0;
+	}
+	for (; n && *l == *r; n--, l++, r++);
+	return n ? *l-*r : 0;
+found:
+	i = a_ctz_64(m);
+	return l[i]-r[i];
+}
+
+static int memcmp_sse2(const void *l, const void *r, size_t n)
+{
+	return memcmp_simd(l, r, n, sse2_ne);
+}
+
+static TARGET_AVX2 int memcmp_avx2(const void *l, const void *r, size_t n)
+{
+	return memcmp_simd(l, r, n, avx2_ne);
+}
+
+static TARGET_AVX512 int memcmp_avx512(const void *l, const void *r, size_t n)
+{
+	return memcmp_simd(l, r, n, avx512_ne);
+}
+
+static int memcmp_init(const void *, const void *, size_t);
+static int (*impl)(const void *, const void *, size_t) = memcmp_init;
+
+static int memcmp_init(const void *l, const void *r, size_t n)
+{
+	static int (*const impls[])(const void *, const void *, size_t) = {
+		memcmp_sse2, memcmp_avx2, memcmp_avx512 };
+	impl = impls[__string_simd_level()];
+	return impl(l, r, n);
+}
+
+int memcmp(const void *l, const void *r, size_t n)
+{
+	return impl(l, r, n);
+}
@@ -0,0 +1,117 @@
+#include <string.h>
+#include "simd.h"
+
+/* Copies up to 256 bytes load everything before storing, with the tail
+ * overlapping the head. Larger copies store the first 32 bytes last and
+ * run an aligned loop over the destination in between, so memcpy also
+ * copies correctly when dest is below src (memmove relies on this, and
+ * so the versions below do not take restrict pointers).
+ * Above the thresholds in simd.h, rep movsb or non-temporal stores take
+ * over; the latter only when the buffers do not overlap. */
+
+SIMD_INLINE void copy_small(unsigned char *d, const unsigned char *s, size_t n)
+{
+	if (n >= 16) {
+		v16 a = *(const v16u *)s, b = *(const v16u *)(s+n-16);
+		*(v16u *)d = a; *(v16u *)(d+n-16) = b;
+	} else if (n >= 8) {
+		uint64_t a = *(const u64u *)s, b = *(const u64u *)(s+n-8);
+		*(u64u *)d = a; *(u64u *)(d+n-8) = b;
+	} else if (n >= 4) {
+		uint32_t a = *(const u32u *)s, b = *(const u32u *)(s+n-4);
+		*(u32u *)d = a; *(u32u *)(d+n-4) = b;
+	} else if (n >= 2) {
+		uint16_t a = *(const u16u *)s, b = *(const u16u *)(s+n-2);
+		*(u16u *)d = a; *(u16u *)(d+n-2) = b;
+	} else if (n) {
+		*d = *s;
+	}
+}
+
+SIMD_INLINE void memcpy_simd(unsigned char *d, const unsigned char *s, size_t n, simd_nt_fn stream)
+{
+	v32 a, b, c, e, f, g, h, i, j;
+	unsigned char *d0 = d;
+	size_t k;
+	int nt;
+
+	if (n <= 32) {
+		copy_small(d, s, n);
+		return;
+	}
+	if (n <= 64) {
+		a = ld32(s); b = ld32(s+n-32);
+		st32(d, a); st32(d+n-32, b);
+		return;
+	}
+	if (n <= 128) {
+		a = ld32(s); b = ld32(s+32); c = ld32(s+n-64); e = ld32(s+n-32);
+		st32(d, a); st32(d+32, b); st32(d+n-64, c); st32(d+n-32, e);
+		return;
+	}
+	if (n <= 256) {
+		a = ld32(s); b = ld32(s+32); c = ld32(s+64); e = ld32(s+96);
+		f = ld32(s+n-128); g = ld32(s+n-96); h = ld32(s+n-64); i = ld32(s+n-32);
+		st32(d, a); st32(d+32, b); st32(d+64, c); st32(d+96, e);
+		st32(d+n-128, f); st32(d+n-96, g); st32(d+n-64, h); st32(d+n-32, i);
+		return;
+	}
+
+	nt = n >= __memcpy_nt_threshold
+		&& (uintptr_t)d - (uintptr_t)s >= n && (uintptr_t)s - (uintptr_t)d >= n;
+	if (n >= __memcpy_rep_threshold && !nt) {
+		__asm__ __volatile__ ("rep movsb"
+			: "+D"(d), "+S"(s), "+c"(n) : : "memory");
+		return;
+	}
+
+	a = ld32(s);
+	f = ld32(s+n-128); g = ld32(s+n-96); h = ld32(s+n-64); i = ld32(s+n-32);
+	k = 32 - ((uintptr_t)d & 31);
+	d += k; s += k; n -= k;
+	if (nt) {
+		for (; n > 128; d += 128, s += 128, n -= 128) {
+			b = ld32(s); c = ld32(s+32); e = ld32(s+64); j = ld32(s+96);
+			stream(d, b); stream(d+32, c); stream(d+64, e); stream(d+96, j);
+		}
+		__asm__ __volatile__ ("sfence" ::: "memory");
+	} else {
+		for (; n > 128; d += 128, s += 128, n -= 128) {
+			b = ld32(s); c = ld32(s+32); e = ld32(s+64); j = ld32(s+96);
+			*(v32 *)d = b; *(v32 *)(d+32) = c;
+			*(v32 *)(d+64) = e; *(v32 *)(d+96) = j;
+		}
+	}
+	st32(d+n-128, f); st32(d+n-96, g); st32(d+n-64, h); st32(d+n-32, i);
+	st32(d0, a);
+}
+
+static void *memcpy_sse2(void *d, const void *s, size_t n)
+{
+	memcpy_simd(d, s, n, sse2_stream);
+	return d;
+}
+
+static TARGET_AVX2 void *memcpy_avx2(void *d, const void *s, size_t n)
+{
+	memcpy_simd(d, s, n, avx2_stream);
+	return d;
+}
+
+static void *memcpy_init(void *, const void *, size_t);
+static void *(*impl)(void *, const void *, size_t) = memcpy_init;
+
+static void *memcpy_init(void *d, const void *s, size_t n)
+{
+	/* rep movsb takes over from the loop above 2 KiB on the machines
+	 * that have AVX-512, so they use the AVX2 version */
+	static void *(*const impls[])(void *, const void *, size_t) = {
+		memcpy_sse2, memcpy_avx2, memcpy_avx2 };
+	impl = impls[__string_simd_level()];
+	return impl(d, s, n);
+}
+
+void *memcpy(void *restrict d, const void *restrict s, size_t n)
+{
+	return impl(d, s, n);
+}
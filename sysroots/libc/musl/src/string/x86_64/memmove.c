@@ -0,0 +1,58 @@
+#include <string.h>
+#include "simd.h"
+
+/* Only overlapping moves to a higher address need to copy backwards;
+ * everything else goes to memcpy, which copies forward and loads small
+ * buffers whole before storing them. Like memcpy, the backward loop
+ * stores to aligned addresses, with the unaligned ends loaded first
+ * and stored last. */
+
+SIMD_INLINE void memmove_back(unsigned char *d, const unsigned char *s, size_t n)
+{
+	v32 a, b, c, e, f, g, h, i, j;
+	unsigned char *end = d + n, *de = end;
+	const unsigned char *se = s + n;
+	size_t k;
+
+	a = ld32(s); b = ld32(s+32); c = ld32(s+64); e = ld32(s+96);
+	f = ld32(se-32);
+	k = (uintptr_t)de & 31;
+	de -= k; se -= k; n -= k;
+	while (n > 128) {
+		de -= 128; se -= 128; n -= 128;
+		g = ld32(se); h = ld32(se+32); i = ld32(se+64); j = ld32(se+96);
+		*(v32 *)(de+96) = j; *(v32 *)(de+64) = i;
+		*(v32 *)(de+32) = h; *(v32 *)de = g;
+	}
+	st32(end-32, f);
+	st32(d, a); st32(d+32, b); st32(d+64, c); st32(d+96, e);
+}
+
+static void memmove_sse2(void *d, const void *s, size_t n)
+{
+	memmove_back(d, s, n);
+}
+
+static TARGET_AVX2 void memmove_avx2(void *d, const void *s, size_t n)
+{
+	memmove_back(d, s, n);
+}
+
+static void memmove_init(void *, const void *, size_t);
+static void (*impl)(void *, const void *, size_t) = memmove_init;
+
+static void memmove_init(void *d, const void *s, size_t n)
+{
+	static void (*const impls[])(void *, const void *, size_t) = {
+		memmove_sse2, memmove_avx2, memmove_avx2 };
+	impl = impls[__string_simd_level()];
+	impl(d, s, n);
+}
+
+void *memmove(void *d, const void *s, size_t n)
+{
+	if ((uintptr_t)d - (uintptr_t)s >= n || n <= 256)
+		return memcpy(d, s, n);
+	impl(d, s, n);
+	return d;
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include "simd.h"
+
+/* Sizes up to 256 bytes are covered by overlapping stores from both
+ * ends. Larger ones store the unaligned ends and run an aligned loop in
+ * between, or use rep stosb or non-temporal stores above the thresholds
+ * in simd.h. */
+
+SIMD_INLINE void memset_simd(unsigned char *d, int c, size_t n, simd_nt_fn stream)
+{
+	v32 v = (v32){0} + (char)c;
+	uint64_t x = 0x0101010101010101 * (unsigned char)c;
+	unsigned char *end = d + n;
+
+	if (n <= 32) {
+		if (n >= 16) {
+			v16 w = (v16){0} + (char)c;
+			*(v16u *)d = w; *(v16u *)(end-16) = w;
+		} else if (n >= 8) {
+			*(u64u *)d = x; *(u64u *)(end-8) = x;
+		} else if (n >= 4) {
+			*(u32u *)d = x; *(u32u *)(end-4) = x;
+		} else if (n >= 2) {
+			*(u16u *)d = x; *(u16u *)(end-2) = x;
+		} else if (n) {
+			*d = c;
+		}
+		return;
+	}
+	if (n >= __memcpy_rep_threshold && n < __memcpy_nt_threshold) {
+		__asm__ __volatile__ ("rep stosb"
+			: "+D"(d), "+c"(n) : "a"(c) : "memory");
+		return;
+	}
+	st32(d, v); st32(end-32, v);
+	if (n <= 64) return;
+	st32(d+32, v); st32(end-64, v);
+	if (n <= 128) return;
+	st32(d+64, v); st32(d+96, v); st32(end-128, v); st32(end-96, v);
+	if (n <= 256) return;
+	d = (void *)((uintptr_t)(d+32) & -32);
+	if (n >= __memcpy_nt_threshold) {
+		for (; d < end-128; d += 128) {
+			stream(d, v); stream(d+32, v); stream(d+64, v); stream(d+96, v);
+		}
+		__asm__ __volatile__ ("sfence" ::: "memory");
+	} else {
+		for (; d < end-128; d += 128) {
+			*(v32 *)d = v; *(v32 *)(d+32) = v;
+			*(v32 *)(d+64) = v; *(v32 *)(d+96) = v;
+		}
+	}
+}
+
+static void *memset_sse2(void *d, int c, size_t n)
+{
+	memset_simd(d, c, n, sse2_stream);
+	return d;
+}
+
+static TARGET_AVX2 void *memset_avx2(void *d, int c, size_t n)
+{
+	memset_simd(d, c, n, avx2_stream);
+	return d;
+}
+
+static void *memset_init(void *, int, size_t);
+static void *(*impl)(void *, int, size_t) = memset_init;
+
+static void *memset_init(void *d, int c, size_t n)
+{
+	static void *(*const impls[])(void *, int, size_t) = {
+		memset_sse2, memset_avx2, memset_avx2 };
+	impl = impls[__string_simd_level()];
+	return impl(d, c, n);
+}
+
+void *memset(void *d, int c, size_t n)
+{
+	return impl(d, c, n);
+}
@@ -0,0 +1,218 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+#include <features.h>
+#include "atomic.h"
+
+/* Vector kernels for the x86_64 string functions.
+ *
+ * Each primitive looks at one 64-byte block and returns a mask with bit i
+ * set for byte i. There is one set per instruction set level (SSE2, AVX2
+ * and AVX-512BW); the string functions are written once against the
+ * primitives and instantiated for each level in a function carrying the
+ * matching target attribute. The level is detected once with CPUID and
+ * each function then calls its implementation through a pointer, which
+ * needs no IFUNC support and so works in static binaries.
+ *
+ * Blocks are read whole, so callers must make sure a block does not
+ * cross into a page that the string does not reach: either by reading
+ * aligned blocks or by checking the page offset first. */
+
+#define SIMD_SSE2   0
+#define SIMD_AVX2   1
+#define SIMD_AVX512 2
+
+hidden int __string_simd_level(void);
+
+/* Size above which memcpy and memset use rep movsb/stosb (ERMS) and
+ * above which they use non-temporal stores instead. SIZE_MAX when not
+ * used. Set up along with the level. */
+hidden extern size_t __memcpy_rep_threshold, __memcpy_nt_threshold;
+
+#define PAGE_SAFE(p) (((uintptr_t)(p) & 4095) <= 4096-64)
+
+typedef char v16 __attribute__((__vector_size__(16), __may_alias__));
+typedef char v32 __attribute__((__vector_size__(32), __may_alias__));
+typedef char v64 __attribute__((__vector_size__(64), __may_alias__));
+typedef char v16u __attribute__((__vector_size__(16), __may_alias__, __aligned__(1)));
+typedef char v32u __attribute__((__vector_size__(32), __may_alias__, __aligned__(1)));
+typedef char v64u __attribute__((__vector_size__(64), __may_alias__, __aligned__(1)));
+
+#define SIMD_INLINE static inline __attribute__((__always_inline__))
+#define TARGET_AVX2 __attribute__((__target__("avx2")))
+#define TARGET_AVX512 __attribute__((__target__("avx2,avx512f,avx512bw")))
+
+typedef uint64_t (*simd_eq_fn)(const unsigned char *, int);
+typedef uint64_t (*simd_ne_fn)(const unsigned char *, const unsigned char *);
+
+/* Unaligned loads and stores for memcpy, memmove and memset. These use
+ * 32-byte vectors at every level: without AVX the compiler splits them
+ * into pairs of SSE2 moves. */
+
+typedef uint16_t u16u __attribute__((__may_alias__, __aligned__(1)));
+typedef uint32_t u32u __attribute__((__may_alias__, __aligned__(1)));
+typedef uint64_t u64u __attribute__((__may_alias__, __aligned__(1)));
+
+typedef void (*simd_nt_fn)(unsigned char *, v32);
+
+SIMD_INLINE v32 ld32(const unsigned char *p)
+{
+	return *(const v32u *)p;
+}
+
+SIMD_INLINE void st32(unsigned char *p, v32 x)
+{
+	*(v32u *)p = x;
+}
+
+/* non-temporal store to a 32-byte aligned p */
+SIMD_INLINE void sse2_stream(unsigned char *p, v32 x)
+{
+	union { v32 v; v16 h[2]; } u = { x };
+	__asm__ ("movntdq %1,%0" : "=m"(*(v16 *)p) : "x"(u.h[0]));
+	__asm__ ("movntdq %1,%0" : "=m"(*(v16 *)(p+16)) : "x"(u.h[1]));
+}
+
+SIMD_INLINE TARGET_AVX2 void avx2_stream(unsigned char *p, v32 x)
+{
+	__asm__ ("vmovntdq %1,%0" : "=m"(*(v32 *)p) : "x"(x));
+}
+
+/* SSE2 */
+
+SIMD_INLINE uint64_t sse2_mask(v16 a, v16 b, v16 c, v16 d)
+{
+	return (uint16_t)__builtin_ia32_pmovmskb128(a)
+		| (uint64_t)(uint16_t)__builtin_ia32_pmovmskb128(b) << 16
+		| (uint64_t)(uint16_t)__builtin_ia32_pmovmskb128(c) << 32
+		| (uint64_t)(uint16_t)__builtin_ia32_pmovmskb128(d) << 48;
+}
+
+SIMD_INLINE v16 sse2_load(const unsigned char *p, int i)
+{
+	return ((const v16u *)p)[i];
+}
+
+/* bytes equal to c */
+SIMD_INLINE uint64_t sse2_eq(const unsigned char *p, int c)
+{
+	v16 k = (v16){0} + (char)c;
+	return sse2_mask(
+		(v16)(sse2_load(p, 0) == k), (v16)(sse2_load(p, 1) == k),
+		(v16)(sse2_load(p, 2) == k), (v16)(sse2_load(p, 3) == k));
+}
+
+/* bytes equal to c or zero */
+SIMD_INLINE uint64_t sse2_eqz(const unsigned char *p, int c)
+{
+	v16 k = (v16){0} + (char)c, z = {0}, a, b, d, e;
+	a = sse2_load(p, 0); b = sse2_load(p, 1);
+	d = sse2_load(p, 2); e = sse2_load(p, 3);
+	return sse2_mask(
+		(v16)((a == k) | (a == z)), (v16)((b == k) | (b == z)),
+		(v16)((d == k) | (d == z)), (v16)((e == k) | (e == z)));
+}
+
+/* bytes that differ */
+SIMD_INLINE uint64_t sse2_ne(const unsigned char *p, const unsigned char *q)
+{
+	return ~sse2_mask(
+		(v16)(sse2_load(p, 0) == sse2_load(q, 0)),
+		(v16)(sse2_load(p, 1) == sse2_load(q, 1)),
+		(v16)(sse2_load(p, 2) == sse2_load(q, 2)),
+		(v16)(sse2_load(p, 3) == sse2_load(q, 3)));
+}
+
+/* bytes that differ or are zero in p */
+SIMD_INLINE uint64_t sse2_nez(const unsigned char *p, const unsigned char *q)
+{
+	v16 z = {0}, a, b;
+	uint64_t m = 0;
+	for (int i = 0; i < 4; i++) {
+		a = sse2_load(p, i); b = sse2_load(q, i);
+		m |= (uint64_t)(uint16_t)__builtin_ia32_pmovmskb128(
+			(v16)((a != b) | (a == z))) << 16*i;
+	}
+	return m;
+}
+
+/* AVX2 */
+
+SIMD_INLINE TARGET_AVX2 uint64_t avx2_mask(v32 a, v32 b)
+{
+	return (uint32_t)__builtin_ia32_pmovmskb256(a)
+		| (uint64_t)(uint32_t)__builtin_ia32_pmovmskb256(b) << 32;
+}
+
+SIMD_INLINE TARGET_AVX2 v32 avx2_load(const unsigned char *p, int i)
+{
+	return ((const v32u *)p)[i];
+}
+
+SIMD_INLINE TARGET_AVX2 uint64_t avx2_eq(const unsigned char *p, int c)
+{
+	v32 k = (v32){0} + (char)c;
+	return avx2_mask((v32)(avx2_load(p, 0) == k), (v32)(avx2_load(p, 1) == k));
+}
+
+SIMD_INLINE TARGET_AVX2 uint64_t avx2_eqz(const unsigned char *p, int c)
+{
+	v32 k = (v32){0} + (char)c, z = {0};
+	v32 a = avx2_load(p, 0), b = avx2_load(p, 1);
+	return avx2_mask((v32)((a == k) | (a == z)), (v32)((b == k) | (b == z)));
+}
+
+SIMD_INLINE TARGET_AVX2 uint64_t avx2_ne(const unsigned char *p, const unsigned char *q)
+{
+	return ~avx2_mask(
+		(v32)(avx2_load(p, 0) == avx2_load(q, 0)),
+		(v32)(avx2_load(p, 1) == avx2_load(q, 1)));
+}
+
+SIMD_INLINE TARGET_AVX2 uint64_t avx2_nez(const unsigned char *p, const unsigned char *q)
+{
+	v32 z = {0};
+	v32 a = avx2_load(p, 0), b = avx2_load(q, 0);
+	v32 c = avx2_load(p, 1), d = avx2_load(q, 1);
+	return avx2_mask((v32)((a != b) | (a == z)), (v32)((c != d) | (c == z)));
+}
+
+/* AVX-512BW: compare straight into a mask register */
+
+#define CMP_EQ 0
+#define CMP_NE 4
+
+SIMD_INLINE TARGET_AVX512 v64 avx512_load(const unsigned char *p)
+{
+	return *(const v64u *)p;
+}
+
+SIMD_INLINE TARGET_AVX512 uint64_t avx512_cmp(v64 a, v64 b, int op)
+{
+	return __builtin_ia32_cmpb512_mask(a, b, op, -1);
+}
+
+SIMD_INLINE TARGET_AVX512 uint64_t avx512_eq(const unsigned char *p, int c)
+{
+	return avx512_cmp(avx512_load(p), (v64){0} + (char)c, CMP_EQ);
+}
+
+SIMD_INLINE TARGET_AVX512 uint64_t avx512_eqz(const unsigned char *p, int c)
+{
+	v64 a = avx512_load(p);
+	return avx512_cmp(a, (v64){0} + (char)c, CMP_EQ) | avx512_cmp(a, (v64){0}, CMP_EQ);
+}
+
+SIMD_INLINE TARGET_AVX512 uint64_t avx512_ne(const unsigned char *p, const unsigned char *q)
+{
+	return avx512_cmp(avx512_load(p), avx512_load(q), CMP_NE);
+}
+
+SIMD_INLINE TARGET_AVX512 uint64_t avx512_nez(const unsigned char *p, const unsigned char *q)
+{
+	v64 a = avx512_load(p);
+	return avx512_cmp(a, avx512_load(q), CMP_NE) | avx512_cmp(a, (v64){0}, CMP_EQ);
+}
+
+#endif
@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include "simd.h"
+
+size_t __memcpy_rep_threshold = -1, __memcpy_nt_threshold = -1;
+
+static void cpuid(unsigned leaf, unsigned sub, unsigned r[4])
+{
+	__asm__ ("cpuid" : "=a"(r[0]), "=b"(r[1]), "=c"(r[2]), "=d"(r[3])
+		: "a"(leaf), "c"(sub));
+}
+
+static uint64_t xgetbv(void)
+{
+	uint32_t a, d;
+	__asm__ ("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return a | (uint64_t)d<<32;
+}
+
+/* size of the largest cache described by the deterministic cache
+ * parameters leaf (4 on Intel, 0x8000001d on AMD), or 0 */
+static size_t llc_size(unsigned leaf)
+{
+	unsigned r[4], i;
+	size_t size, max = 0;
+	for (i = 0; i < 16; i++) {
+		cpuid(leaf, i, r);
+		if (!(r[0] & 31)) break;
+		size = (size_t)((r[1]>>22) + 1) * ((r[1]>>12 & 0x3ff) + 1)
+			* ((r[1] & 0xfff) + 1) * ((size_t)r[2] + 1);
+		if (size > max) max = size;
+	}
+	return max;
+}
+
+static void mem_tune(unsigned max, unsigned ebx7)
+{
+	unsigned r[4];
+	size_t llc = 0;
+
+	if (max >= 4) llc = llc_size(4);
+	cpuid(0x80000000, 0, r);
+	if (!llc && r[0] >= 0x8000001d) llc = llc_size(0x8000001d);
+	if (!llc) llc = 8<<20;
+	/* stream copies that would take a quarter of the last level cache
+	 * rather than evict what is in it */
+	__memcpy_nt_threshold = llc / 4;
+	if (ebx7 & 1<<9) __memcpy_rep_threshold = 2048;
+}
+
+int __string_simd_level(void)
+{
+	static volatile int level = -1;
+	unsigned r[4], max, ebx7 = 0;
+	uint64_t xcr0;
+	int l = level;
+
+	if (l >= 0) return l;
+	l = SIMD_SSE2;
+	cpuid(0, 0, r);
+	max = r[0];
+	if (max >= 7) {
+		cpuid(7, 0, r);
+		ebx7 = r[1];
+	}
+	cpuid(1, 0, r);
+	/* AVX and OSXSAVE, then the OS must save the xmm/ymm state */
+	if (max >= 7 && (r[2] & 0x18000000) == 0x18000000) {
+		xcr0 = xgetbv();
+		if ((xcr0 & 0x06) == 0x06 && (ebx7 & 1<<5))
+			l = SIMD_AVX2;
+		/* AVX512F, AVX512BW and the opmask/zmm state */
+		if (l == SIMD_AVX2 && (xcr0 & 0xe6) == 0xe6
+		    && (ebx7 & (1<<16 | 1<<30)) == (1<<16 | 1<<30))
+			l = SIMD_AVX512;
+	}
+	mem_tune(max, ebx7);
+	level = l;
+	return l;
+}
+
+/* Called by __init_libc once __environ is set, but not in secure
+ * (setuid etc) programs: MUSL_MEMCPY_NT_THRESHOLD=bytes overrides the
+ * size above which memcpy, memmove and memset bypass the cache; 0
+ * disables that. */
+hidden void __string_init_env(void)
+{
+	size_t nt;
+	char *e = getenv("MUSL_MEMCPY_NT_THRESHOLD");
+	if (!e) return;
+	for (nt = 0; *e >= '0' && *e <= '9'; e++)
+		nt = 10*nt + (*e - '0');
+	if (*e) return;
+	__string_simd_level();
+	__memcpy_nt_threshold = nt ? nt : -1;
+}
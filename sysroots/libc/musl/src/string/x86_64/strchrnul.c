@@ -0,0 +1,46 @@
+#include <string.h>
+#include "simd.h"
+
+SIMD_INLINE char *strchrnul_simd(const char *s, int c, simd_eq_fn eqz)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -64);
+	uint64_t m = eqz(p, c) >> ((uintptr_t)s & 63);
+	if (m) return (char *)s + a_ctz_64(m);
+	for (;;) {
+		p += 64;
+		if ((m = eqz(p, c))) return (char *)p + a_ctz_64(m);
+	}
+}
+
+static char *strchrnul_sse2(const char *s, int c)
+{
+	return strchrnul_simd(s, c, sse2_eqz);
+}
+
+static TARGET_AVX2 char *strchrnul_avx2(const char *s, int c)
+{
+	return strchrnul_simd(s, c, avx2_eqz);
+}
+
+static TARGET_AVX512 char *strchrnul_avx512(const char *s, int c)
+{
+	return strchrnul_simd(s, c, avx512_eqz);
+}
+
+static char *strchrnul_init(const char *, int);
+static char *(*impl)(const char *, int) = strchrnul_init;
+
+static char *strchrnul_init(const char *s, int c)
+{
+	static char *(*const impls[])(const char *, int) = {
+		strchrnul_sse2, strchrnul_avx2, strchrnul_avx512 };
+	impl = impls[__string_simd_level()];
+	return impl(s, c);
+}
+
+char *__strchrnul(const char *s, int c)
+{
+	return impl(s, c);
+}
+
+weak_alias(__strchrnul, strchrnul);
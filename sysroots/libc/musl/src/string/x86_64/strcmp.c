@@ -0,0 +1,63 @@
+#include <string.h>
+#include "simd.h"
+
+SIMD_INLINE int strcmp_simd(const char *sl, const char *sr, simd_ne_fn nez)
+{
+	const unsigned char *l = (const void *)sl, *r = (const void *)sr;
+	uint64_t m;
+	size_t i, k, kr;
+
+	for (;;) {
+		if (PAGE_SAFE(l) && PAGE_SAFE(r)) {
+			if ((m = nez(l, r))) break;
+			l += 64; r += 64;
+			continue;
+		}
+		/* a block would cross into the next page: advance k bytes to
+		 * the page end nearest to l or r. Once 64-k bytes are behind
+		 * us, use the block that ends there; else compare bytewise. */
+		k = 4096 - ((uintptr_t)l & 4095);
+		kr = 4096 - ((uintptr_t)r & 4095);
+		if (kr < k) k = kr;
+		if (l - (const unsigned char *)sl >= 64-k) {
+			if ((m = nez(l+k-64, r+k-64) >> (64-k))) break;
+		} else {
+			for (i = 0; i < k; i++)
+				if (l[i] != r[i] || !l[i]) return l[i]-r[i];
+		}
+		l += k; r += k;
+	}
+	i = a_ctz_64(m);
+	return l[i]-r[i];
+}
+
+static int strcmp_sse2(const char *l, const char *r)
+{
+	return strcmp_simd(l, r, sse2_nez);
+}
+
+static TARGET_AVX2 int strcmp_avx2(const char *l, const char *r)
+{
+	return strcmp_simd(l, r, avx2_nez);
+}
+
+static TARGET_AVX512 int strcmp_avx512(const char *l, const char *r)
+{
+	return strcmp_simd(l, r, avx512_nez);
+}
+
+static int strcmp_init(const char *, const char *);
+static int (*impl)(const char *, const char *) = strcmp_init;
+
+static int strcmp_init(const char *l, const char *r)
+{
+	static int (*const impls[])(const char *, const char *) = {
+		strcmp_sse2, strcmp_avx2, strcmp_avx512 };
+	impl = impls[__string_simd_level()];
+	return impl(l, r);
+}
+
+int strcmp(const char *l, const char *r)
+{
+	return impl(l, r);
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include "simd.h"
+
+SIMD_INLINE size_t strlen_simd(const char *s, simd_eq_fn eq)
+{
+	const unsigned char *p = (const void *)((uintptr_t)s & -64);
+	uint64_t m = eq(p, 0) >> ((uintptr_t)s & 63);
+	if (m) return a_ctz_64(m);
+	for (;;) {
+		p += 64;
+		if ((m = eq(p, 0))) return p + a_ctz_64(m) - (const unsigned char *)s;
+	}
+}
+
+static size_t strlen_sse2(const char *s)
+{
+	return strlen_simd(s, sse2_eq);
+}
+
+static TARGET_AVX2 size_t strlen_avx2(const char *s)
+{
+	return strlen_simd(s, avx2_eq);
+}
+
+static TARGET_AVX512 size_t strlen_avx512(const char *s)
+{
+	return strlen_simd(s, avx512_eq);
+}
+
+static size_t strlen_init(const char *);
+static size_t (*impl)(const char *) = strlen_init;
+
+static size_t strlen_init(const char *s)
+{
+	static size_t (*const impls[])(const char *) = {
+		strlen_sse2, strlen_avx2, strlen_avx512 };
+	impl = impls[__string_simd_level()];
+	return impl(s);
+}
+
+size_t strlen(const char *s)
+{
+	return impl(s);
+}
@@ -16,6 +16,8 @@
  * with INT_MIN as a lock flag.
  */
 
+static volatile int spin_avg;
+
 void __lock(volatile int *l)
 {
 	int need_locks = libc.need_locks;
@@ -24,14 +26,26 @@ void __lock(volatile int *l)
 	int current = a_cas(l, 0, INT_MIN + 1);
 	if (need_locks < 0) libc.need_locks = 0;
 	if (!current) return;
-	/* A first spin loop, for medium congestion. */
-	for (unsigned i = 0; i < 10; ++i) {
-		if (current < 0) current -= INT_MIN + 1;
-		// assertion: current >= 0
-		int val = a_cas(l, current, INT_MIN + (current + 1));
-		if (val == current) return;
-		current = val;
+	/* A first spin loop, for medium congestion. Take the lock when it
+	 * is free; while it is held, spin only as long as the holder is
+	 * alone in the CS (nobody sleeps on it yet), for an adaptive number
+	 * of rounds shared by all internal locks. */
+	int limit = __spin_limit(spin_avg), spins;
+	for (spins = 0; spins <= limit; spins++) {
+		if (current >= 0) {
+			int val = a_cas(l, current, INT_MIN + (current + 1));
+			if (val == current) {
+				if (limit) __spin_update(&spin_avg, spins);
+				return;
+			}
+			current = val;
+			continue;
+		}
+		if (current != INT_MIN + 1) break;
+		a_spin();
+		current = *l;
 	}
+	if (limit && spins > limit) __spin_update(&spin_avg, limit);
 	// Spinning failed, so mark ourselves as being inside the CS.
 	current = a_fetch_add(l, 1) + 1;
 	/* The main lock acquisition loop for heavy congestion. The only
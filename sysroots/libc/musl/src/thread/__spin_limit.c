@@ -0,0 +1,34 @@
+#include "pthread_impl.h"
+
+/* Spinning on a held lock only pays off while its owner is running on
+ * another CPU and about to release it. Userspace cannot see whether
+ * the owner is running, so the amount of spinning is bounded by what
+ * is observed instead:
+ *
+ * - with only one CPU to run on, the owner cannot make progress while
+ *   we spin, so there is no spinning at all;
+ * - callers stop as soon as some other thread sleeps on the lock;
+ * - each lock keeps a decaying average of the rounds after which it
+ *   was found free, counting a spin that ran out as the full limit,
+ *   and waiters spin for up to twice that, capped at SPIN_MAX. */
+
+static int ncpu;
+
+int __cpu_count(void)
+{
+	if (!ncpu) {
+		unsigned char set[128];
+		int i, n = 0, r = __syscall(SYS_sched_getaffinity, 0, sizeof set, set);
+		for (i = 0; i < r; i++)
+			for (; set[i]; set[i] &= set[i]-1) n++;
+		ncpu = n ? n : 2;
+	}
+	return ncpu;
+}
+
+int __spin_limit(int avg)
+{
+	if (__cpu_count() == 1) return 0;
+	avg = 2*avg + 10;
+	return avg < SPIN_MAX ? avg : SPIN_MAX;
+}
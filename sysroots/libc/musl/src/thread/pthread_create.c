@@ -16,6 +16,7 @@ weak_alias(dummy_0, __pthread_tsd_run_dtors);
 weak_alias(dummy_0, __do_orphaned_stdio_locks);
 weak_alias(dummy_0, __dl_thread_cleanup);
 weak_alias(dummy_0, __membarrier_init);
+weak_alias(dummy_0, __malloc_tcache_flush);
 
 static int tl_lock_count;
 static int tl_lock_waiters;
@@ -68,6 +69,7 @@ _Noreturn void __pthread_exit(void *result)
 	}
 
 	__pthread_tsd_run_dtors();
+	__malloc_tcache_flush();
 
 	__block_app_sigs(&set);
 
@@ -67,8 +67,16 @@ int __pthread_mutex_timedlock(pthread_mutex_t *restrict m, const struct timespec
 
 	if (type&8) return pthread_mutex_timedlock_pi(m, at);
 	
-	int spins = 100;
-	while (spins-- && m->_m_lock && !m->_m_waiters) a_spin();
+	/* Only NORMAL mutexes have room to remember how long spinning
+	 * took; the others always spin for up to SPIN_MAX rounds. */
+	int normal = !(type&15);
+	int spins = 0, limit = __spin_limit(normal ? m->_m_spins : SPIN_MAX);
+	while (spins < limit && m->_m_lock && !m->_m_waiters) {
+		a_spin();
+		spins++;
+	}
+	if (normal && limit && !m->_m_waiters)
+		__spin_update(&m->_m_spins, m->_m_lock ? limit : spins);
 
 	while ((r=__pthread_mutex_trylock(m)) == EBUSY) {
 		r = m->_m_lock;
@@ -1,6 +1,14 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *rw)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_destroy);
+
 int pthread_rwlock_destroy(pthread_rwlock_t *rw)
 {
+	if (rw->_rw_shards) __pthread_rwlock_sharded_destroy(rw);
 	return 0;
 }
@@ -1,8 +1,16 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *rw)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_shard);
+
 int pthread_rwlock_init(pthread_rwlock_t *restrict rw, const pthread_rwlockattr_t *restrict a)
 {
 	*rw = (pthread_rwlock_t){0};
 	if (a) rw->_rw_shared = a->__attr[0]*128;
+	if (!rw->_rw_shared) __pthread_rwlock_shard(rw);
 	return 0;
 }
@@ -0,0 +1,219 @@
+#include <stdlib.h>
+#include <string.h>
+#include "pthread_impl.h"
+
+/* Reader-scalable rwlocks. Every read lock and unlock of a plain
+ * rwlock modifies _rw_lock, so with readers on many CPUs its cache
+ * line bounces between them even though they never wait for each
+ * other. With this file linked, pthread_rwlock_init gives each
+ * process-private rwlock an array of reader counts, one per cache
+ * line and about one per CPU. A reader only increments and decrements
+ * the count picked by its thread id, and _rw_lock only holds writers:
+ *
+ * 0:       no writer
+ * INTENT:  a writer is checking that no reader is in
+ * HELD:    a writer holds the lock
+ *
+ * with the sign bit set when someone sleeps on it. A reader that finds
+ * a writer there backs out of its count and waits on _rw_lock. A writer
+ * takes INTENT, and when it then sums the counts to zero it holds the
+ * lock; both sides do an atomic op before looking at the other side's
+ * state, so one of them always sees the other. If readers are in, the
+ * writer drops INTENT so that they (and recursive read locks) can go
+ * on, and waits for the readers in each shard to leave: it adds
+ * DRAINER to the shard's count, which tells leaving readers to wake
+ * it. Like plain rwlocks, readers are preferred over waiting writers.
+ *
+ * Once its count is decremented a reader doesn't touch the shards
+ * again, as a writer may then take the lock and destroy it. Like the
+ * unlock of a plain rwlock, it only wakes waiters on the futex.
+ *
+ * Sharded rwlocks are not linked by default, since each costs a few
+ * cache lines per CPU (up to 4 kB) of heap. Link with
+ *   -Wl,-u,__pthread_rwlock_sharded_enable
+ * to use them. Statically initialized, process-shared and, when there
+ * is only one CPU, all rwlocks stay plain. */
+
+#define LINE 64
+#define MAX_SHARDS 64
+#define INTENT 0x7ffffffe
+#define HELD 0x7fffffff
+#define DRAINER 0x100000
+#define READERS (DRAINER-1)
+
+struct shards {
+	int mask;
+	char pad[LINE - sizeof(int)];
+	struct {
+		volatile int readers;
+		char pad[LINE - sizeof(int)];
+	} s[];
+};
+
+const char __pthread_rwlock_sharded_enable = 1;
+
+int __pthread_rwlock_shard(pthread_rwlock_t *rw)
+{
+	struct shards *sh;
+	int n = 1, ncpu = __cpu_count();
+	if (ncpu == 1) return 0;
+	while (n < ncpu && n < MAX_SHARDS) n *= 2;
+	sh = aligned_alloc(LINE, sizeof *sh + n * sizeof sh->s[0]);
+	if (!sh) return 0;
+	memset(sh, 0, sizeof *sh + n * sizeof sh->s[0]);
+	sh->mask = n-1;
+	rw->_rw_shards = sh;
+	return 1;
+}
+
+int __pthread_rwlock_sharded_destroy(pthread_rwlock_t *rw)
+{
+	free(rw->_rw_shards);
+	rw->_rw_shards = 0;
+	return 0;
+}
+
+static volatile int *count(struct shards *sh)
+{
+	return &sh->s[__pthread_self()->tid & sh->mask].readers;
+}
+
+static int readers(struct shards *sh)
+{
+	int i, n = 0;
+	for (i = 0; i <= sh->mask; i++) n += sh->s[i].readers & READERS;
+	return n;
+}
+
+/* A reader leaves, waking writers waiting for readers to. */
+static void leave(struct shards *sh)
+{
+	volatile int *c = count(sh);
+	if (a_fetch_add(c, -1) & ~READERS)
+		__wake(c, -1, 1);
+}
+
+/* A writer waits for the readers in each shard to leave. Readers can
+ * come back meanwhile, so the caller checks again. */
+static int drain(struct shards *sh, const struct timespec *at)
+{
+	int i, v, r = 0;
+	for (i = 0; i <= sh->mask && (!r || r == EINTR); i++) {
+		volatile int *c = &sh->s[i].readers;
+		if (!(*c & READERS)) continue;
+		a_fetch_add(c, DRAINER);
+		while (((v = *c) & READERS) && (!r || r == EINTR))
+			r = __timedwait(c, v, CLOCK_REALTIME, at, 1);
+		a_fetch_add(c, -DRAINER);
+	}
+	return r;
+}
+
+/* A writer drops INTENT or the lock. */
+static void release(pthread_rwlock_t *rw)
+{
+	int val = a_swap(&rw->_rw_lock, 0);
+	if (val < 0 || rw->_rw_waiters)
+		__wake(&rw->_rw_lock, -1, 1);
+}
+
+/* A writer with INTENT and no readers in takes the lock, keeping the
+ * sign bit set if a waiter set it meanwhile. */
+static void commit(pthread_rwlock_t *rw)
+{
+	int val;
+	do val = rw->_rw_lock;
+	while (a_cas(&rw->_rw_lock, val, val|HELD) != val);
+}
+
+static void spin(pthread_rwlock_t *rw)
+{
+	int spins = 0, limit = __spin_limit(rw->_rw_spins);
+	while (spins < limit && rw->_rw_lock && !rw->_rw_waiters) {
+		a_spin();
+		spins++;
+	}
+	if (limit && !rw->_rw_waiters)
+		__spin_update(&rw->_rw_spins, rw->_rw_lock ? limit : spins);
+}
+
+/* Sleeps on _rw_lock while it has the nonzero value r. */
+static int wait_writer(pthread_rwlock_t *rw, int r, const struct timespec *at)
+{
+	int t = r | 0x80000000;
+	a_inc(&rw->_rw_waiters);
+	a_cas(&rw->_rw_lock, r, t);
+	r = __timedwait(&rw->_rw_lock, t, CLOCK_REALTIME, at, 1);
+	a_dec(&rw->_rw_waiters);
+	return r;
+}
+
+int __pthread_rwlock_sharded_tryrdlock(pthread_rwlock_t *rw)
+{
+	struct shards *sh = rw->_rw_shards;
+	a_inc(count(sh));
+	if (!rw->_rw_lock) return 0;
+	leave(sh);
+	return EBUSY;
+}
+
+int __pthread_rwlock_sharded_timedrdlock(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
+{
+	int r;
+
+	r = __pthread_rwlock_sharded_tryrdlock(rw);
+	if (r != EBUSY) return r;
+
+	spin(rw);
+
+	while ((r=__pthread_rwlock_sharded_tryrdlock(rw))==EBUSY) {
+		if (!(r=rw->_rw_lock)) continue;
+		r = wait_writer(rw, r, at);
+		if (r && r != EINTR) return r;
+	}
+	return r;
+}
+
+int __pthread_rwlock_sharded_trywrlock(pthread_rwlock_t *rw)
+{
+	if (a_cas(&rw->_rw_lock, 0, INTENT)) return EBUSY;
+	if (readers(rw->_rw_shards)) {
+		release(rw);
+		return EBUSY;
+	}
+	commit(rw);
+	return 0;
+}
+
+int __pthread_rwlock_sharded_timedwrlock(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
+{
+	struct shards *sh = rw->_rw_shards;
+	int r, spun = 0;
+
+	for (;;) {
+		if (!(r = a_cas(&rw->_rw_lock, 0, INTENT))) {
+			if (!readers(sh)) {
+				commit(rw);
+				return 0;
+			}
+			release(rw);
+			r = drain(sh, at);
+			if (r && r != EINTR) return r;
+			continue;
+		}
+		/* Another writer has the lock or is about to. */
+		if (!spun++) {
+			spin(rw);
+			continue;
+		}
+		r = wait_writer(rw, r, at);
+		if (r && r != EINTR) return r;
+	}
+}
+
+int __pthread_rwlock_sharded_unlock(pthread_rwlock_t *rw)
+{
+	if ((rw->_rw_lock & HELD) == HELD) release(rw);
+	else leave(rw->_rw_shards);
+	return 0;
+}
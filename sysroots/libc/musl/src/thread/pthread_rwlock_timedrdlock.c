@@ -1,14 +1,35 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_timedrdlock);
+
+static inline int writer_holds(pthread_rwlock_t *rw)
+{
+	return (rw->_rw_lock & 0x7fffffff) == 0x7fffffff;
+}
+
 int __pthread_rwlock_timedrdlock(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
 {
 	int r, t;
 
+	if (rw->_rw_shards) return __pthread_rwlock_sharded_timedrdlock(rw, at);
+
 	r = pthread_rwlock_tryrdlock(rw);
 	if (r != EBUSY) return r;
 	
-	int spins = 100;
-	while (spins-- && rw->_rw_lock && !rw->_rw_waiters) a_spin();
+	/* Spin only while a writer holds the lock; other readers do not
+	 * keep us out. */
+	int spins = 0, limit = __spin_limit(rw->_rw_spins);
+	while (spins < limit && writer_holds(rw) && !rw->_rw_waiters) {
+		a_spin();
+		spins++;
+	}
+	if (limit && !rw->_rw_waiters)
+		__spin_update(&rw->_rw_spins, writer_holds(rw) ? limit : spins);
 
 	while ((r=__pthread_rwlock_tryrdlock(rw))==EBUSY) {
 		if (!(r=rw->_rw_lock) || (r&0x7fffffff)!=0x7fffffff) continue;
@@ -1,14 +1,28 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_timedwrlock);
+
 int __pthread_rwlock_timedwrlock(pthread_rwlock_t *restrict rw, const struct timespec *restrict at)
 {
 	int r, t;
 	
+	if (rw->_rw_shards) return __pthread_rwlock_sharded_timedwrlock(rw, at);
+
 	r = pthread_rwlock_trywrlock(rw);
 	if (r != EBUSY) return r;
 	
-	int spins = 100;
-	while (spins-- && rw->_rw_lock && !rw->_rw_waiters) a_spin();
+	int spins = 0, limit = __spin_limit(rw->_rw_spins);
+	while (spins < limit && rw->_rw_lock && !rw->_rw_waiters) {
+		a_spin();
+		spins++;
+	}
+	if (limit && !rw->_rw_waiters)
+		__spin_update(&rw->_rw_spins, rw->_rw_lock ? limit : spins);
 
 	while ((r=__pthread_rwlock_trywrlock(rw))==EBUSY) {
 		if (!(r=rw->_rw_lock)) continue;
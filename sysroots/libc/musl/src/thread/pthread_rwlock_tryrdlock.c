@@ -1,8 +1,16 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *rw)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_tryrdlock);
+
 int __pthread_rwlock_tryrdlock(pthread_rwlock_t *rw)
 {
 	int val, cnt;
+	if (rw->_rw_shards) return __pthread_rwlock_sharded_tryrdlock(rw);
 	do {
 		val = rw->_rw_lock;
 		cnt = val & 0x7fffffff;
@@ -1,7 +1,15 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *rw)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_trywrlock);
+
 int __pthread_rwlock_trywrlock(pthread_rwlock_t *rw)
 {
+	if (rw->_rw_shards) return __pthread_rwlock_sharded_trywrlock(rw);
 	if (a_cas(&rw->_rw_lock, 0, 0x7fffffff)) return EBUSY;
 	return 0;
 }
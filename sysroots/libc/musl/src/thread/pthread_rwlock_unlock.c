@@ -1,9 +1,18 @@
 #include "pthread_impl.h"
 
+static int dummy(pthread_rwlock_t *rw)
+{
+	return 0;
+}
+
+weak_alias(dummy, __pthread_rwlock_sharded_unlock);
+
 int __pthread_rwlock_unlock(pthread_rwlock_t *rw)
 {
 	int val, cnt, waiters, new, priv = rw->_rw_shared^128;
 
+	if (rw->_rw_shards) return __pthread_rwlock_sharded_unlock(rw);
+
 	do {
 		val = rw->_rw_lock;
 		cnt = val & 0x7fffffff;
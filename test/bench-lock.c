@@ -0,0 +1,130 @@
+// Lock contention benchmark: runs 1, 2, 4, ... threads that all take the
+// same lock, for mutexes with short and longer critical sections, rwlocks
+// with only readers and with 1% writers, and malloc+free (libc's internal
+// lock), and prints the total number of lock operations per second. Link
+// with -Wl,-u,__pthread_rwlock_sharded_enable to use musl's sharded
+// (reader-scalable) rwlocks:
+//   clang-x86_64-linux -O2 test/bench-lock.c -o bench-lock
+//   clang-x86_64-linux -O2 test/bench-lock.c -o bench-lock-sharded \
+//     -Wl,-u,__pthread_rwlock_sharded_enable
+//   ./bench-lock [maxthreads]
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAXTHREADS 256
+
+enum { MUTEX, MUTEX_LONG, RWLOCK_READ, RWLOCK_WRITE1, MALLOC, NWORKLOADS };
+
+static const char* names[] = {
+  "mutex", "mutex (long)", "rwlock (read)", "rwlock (1% wr)", "malloc+free",
+};
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t rwlock;
+static pthread_barrier_t barrier;
+static volatile int stop;
+static volatile uint64_t shared[8];
+static int workload;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// work does n rounds of arithmetic the compiler can't drop
+static uint64_t work(uint64_t x, int n) {
+  for (int i = 0; i < n; i++)
+    x = x * 6364136223846793005ull + 1442695040888963407ull;
+  return x;
+}
+
+static void* worker(void* arg) {
+  uint64_t x = (uintptr_t)arg, n = 0;
+  pthread_barrier_wait(&barrier);
+  while (!stop) {
+    for (int i = 0; i < 100; i++, n++) {
+      switch (workload) {
+        case MUTEX:
+        case MUTEX_LONG:
+          pthread_mutex_lock(&mutex);
+          shared[0] = work(shared[0], workload == MUTEX ? 1 : 50);
+          pthread_mutex_unlock(&mutex);
+          break;
+        case RWLOCK_READ:
+        case RWLOCK_WRITE1:
+          if (workload == RWLOCK_WRITE1 && (n % 100) == 0) {
+            pthread_rwlock_wrlock(&rwlock);
+            shared[0] = work(shared[0], 1);
+            pthread_rwlock_unlock(&rwlock);
+          } else {
+            pthread_rwlock_rdlock(&rwlock);
+            x += shared[0];
+            pthread_rwlock_unlock(&rwlock);
+          }
+          break;
+        default: {
+          void* volatile p = malloc(16 + (n & 63));
+          free(p);
+          break;
+        }
+      }
+      // some work outside the lock, as real programs do
+      x = work(x, 10);
+    }
+  }
+  shared[1] = x;
+  return (void*)(uintptr_t)n;
+}
+
+// run starts nthreads workers, lets them run for roughly 200 ms and returns
+// millions of lock operations per second
+static double run(int nthreads) {
+  static pthread_t t[MAXTHREADS];
+  uint64_t total = 0;
+  stop = 0;
+  pthread_barrier_init(&barrier, NULL, (unsigned)nthreads + 1);
+  for (int i = 0; i < nthreads; i++) {
+    if (pthread_create(&t[i], NULL, worker, (void*)(uintptr_t)(i + 1))) {
+      perror("pthread_create");
+      exit(1);
+    }
+  }
+  pthread_barrier_wait(&barrier);
+  double start = now();
+  struct timespec ts = { 0, 200000000 };
+  nanosleep(&ts, NULL);
+  stop = 1;
+  for (int i = 0; i < nthreads; i++) {
+    void* n;
+    pthread_join(t[i], &n);
+    total += (uintptr_t)n;
+  }
+  double elapsed = now() - start;
+  pthread_barrier_destroy(&barrier);
+  return (double)total / elapsed / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+  int maxthreads = argc > 1 ? atoi(argv[1]) : 8;
+  if (maxthreads > MAXTHREADS)
+    maxthreads = MAXTHREADS;
+  pthread_rwlock_init(&rwlock, NULL);
+  printf("%-16s", "threads");
+  for (int n = 1; n <= maxthreads; n *= 2)
+    printf("  %7d", n);
+  printf("  (Mops/s)\n");
+  for (workload = 0; workload < NWORKLOADS; workload++) {
+    printf("%-16s", names[workload]);
+    for (int n = 1; n <= maxthreads; n *= 2) {
+      printf("  %7.2f", run(n));
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  pthread_rwlock_destroy(&rwlock);
+  return 0;
+}
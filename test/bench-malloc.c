@@ -0,0 +1,77 @@
+// Multithreaded malloc benchmark: each thread allocates and frees blocks of
+// random small sizes, keeping a working set of live blocks. Prints the
+// throughput for 1, 2, 4 ... maxthreads threads.
+// Compare musl's malloc (mallocng), mallocng with the per-thread cache and
+// the scalable malloc of libmalloc-fast.a:
+//   clang-x86_64-linux -O2 test/bench-malloc.c -o bench-malloc
+//   clang-x86_64-linux -O2 test/bench-malloc.c -o bench-malloc-tcache \
+//     -Wl,-u,__malloc_tcache_enable
+//   clang-x86_64-linux -O2 test/bench-malloc.c -o bench-malloc-fast -lmalloc-fast
+//   ./bench-malloc [maxthreads [ops-per-thread]]
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define WORKING_SET 256
+#define MAX_SIZE    512
+
+static long nops = 1000000;
+
+static uint32_t rand32(uint32_t* state) {
+  // xorshift32
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+static void* worker(void* arg) {
+  void* live[WORKING_SET] = {0};
+  uint32_t rnd = (uint32_t)(uintptr_t)arg * 2654435761u + 1;
+  for (long i = 0; i < nops; i++) {
+    uint32_t r = rand32(&rnd);
+    int slot = (int)(r % WORKING_SET);
+    free(live[slot]);
+    size_t size = 1 + (r >> 16) % MAX_SIZE;
+    if (!(live[slot] = malloc(size))) {
+      perror("malloc");
+      exit(1);
+    }
+    *(volatile char*)live[slot] = 1;
+  }
+  for (int i = 0; i < WORKING_SET; i++)
+    free(live[i]);
+  return NULL;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  int maxthreads = argc > 1 ? atoi(argv[1]) : 64;
+  if (argc > 2)
+    nops = atol(argv[2]);
+  pthread_t* threads = malloc(sizeof(pthread_t) * (size_t)maxthreads);
+
+  printf("threads  Mops/s  Mops/s/thread\n");
+  for (int nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+    double start = now();
+    for (int i = 0; i < nthreads; i++) {
+      if (pthread_create(&threads[i], NULL, worker, (void*)(uintptr_t)(i + 1)) != 0) {
+        perror("pthread_create");
+        return 1;
+      }
+    }
+    for (int i = 0; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+    double mops = (double)nops * nthreads / (now() - start) / 1e6;
+    printf("%7d  %6.1f  %13.2f\n", nthreads, mops, mops / nthreads);
+  }
+  return 0;
+}
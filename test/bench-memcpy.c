@@ -0,0 +1,85 @@
+// Memory bandwidth benchmark: times memcpy, memmove (with dest above src,
+// overlapping) and memset on sizes from 8 bytes to 64 MiB, for aligned and
+// misaligned buffers, and prints the throughput in GB/s. Sizes that don't
+// fit in the caches measure memory bandwidth; compare them with and without
+// non-temporal stores:
+//   clang-x86_64-linux -O2 test/bench-memcpy.c -o bench-memcpy
+//   ./bench-memcpy [maxsize]
+//   MUSL_MEMCPY_NT_THRESHOLD=0 ./bench-memcpy   # never bypass the cache
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// volatile function pointers keep the compiler from folding or inlining calls
+static void* (*volatile fn_memcpy)(void*, const void*, size_t) = memcpy;
+static void* (*volatile fn_memmove)(void*, const void*, size_t) = memmove;
+static void* (*volatile fn_memset)(void*, int, size_t) = memset;
+
+static const struct { size_t dst, src; } alignments[] = {
+  { 0, 0 }, { 0, 5 }, { 13, 0 }, { 1, 63 },
+};
+#define NALIGN (sizeof(alignments) / sizeof(alignments[0]))
+
+static unsigned char* a;
+static unsigned char* b;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// run calls f for roughly 20 ms and returns the throughput in GB/s
+static double run(int f, size_t size, size_t dstoff, size_t srcoff) {
+  unsigned char* d = b + dstoff;
+  const unsigned char* s = a + srcoff;
+  long iters = (long)(((size_t)1 << 24) / (size + 16)) + 1, n = 0;
+  double start = now(), elapsed;
+  do {
+    for (long i = 0; i < iters; i++) {
+      switch (f) {
+        case 0: fn_memcpy(d, s, size); break;
+        case 1: fn_memmove(d + 64, d, size); break;
+        default: fn_memset(d, (int)i, size); break;
+      }
+    }
+    n += iters;
+  } while ((elapsed = now() - start) < 0.02);
+  return (double)size * (double)n / elapsed / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  static const char* names[] = { "memcpy", "memmove", "memset" };
+  size_t maxsize = argc > 1 ? (size_t)atol(argv[1]) : (size_t)64 << 20;
+  a = malloc(maxsize + 256);
+  b = malloc(maxsize + 256);
+  if (!a || !b) {
+    perror("malloc");
+    return 1;
+  }
+  // touch the buffers so that page faults are not measured
+  memset(a, 1, maxsize + 256);
+  memset(b, 2, maxsize + 256);
+  // align both to 64 bytes so that the offsets below are the alignments
+  a = (unsigned char*)(((uintptr_t)a + 63) & ~(uintptr_t)63);
+  b = (unsigned char*)(((uintptr_t)b + 63) & ~(uintptr_t)63);
+
+  for (int f = 0; f < 3; f++) {
+    printf("%s (GB/s)\n%10s", names[f], "size");
+    for (size_t i = 0; i < NALIGN; i++) {
+      char label[16];
+      snprintf(label, sizeof(label), "%zu/%zu", alignments[i].dst, alignments[i].src);
+      printf("  %7s", label);
+    }
+    printf("\n");
+    for (size_t size = 8; size <= maxsize; size *= 2) {
+      printf("%10zu", size);
+      for (size_t i = 0; i < NALIGN; i++)
+        printf("  %7.2f", run(f, size, alignments[i].dst, alignments[i].src));
+      printf("\n");
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,80 @@
+// printf benchmark: times snprintf, and fprintf to a fully buffered FILE,
+// for integer, string and floating point conversions and prints the number
+// of calls per second.
+//   clang-x86_64-linux -O2 test/bench-printf.c -o bench-printf
+//   ./bench-printf
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double vals[256];
+static volatile int sink;
+
+// run formats with fmt for roughly 100 ms and returns millions of calls
+// per second; f is NULL for snprintf
+static double run(FILE* f, const char* fmt, int kind) {
+  char buf[512];
+  long n = 0;
+  double start = now(), elapsed;
+  do {
+    for (int i = 0; i < 1000; i++) {
+      double x = vals[i & 255];
+      long long v = (long long)(x * 1e6);
+      int r;
+      switch (kind) {
+        case 'i': r = f ? fprintf(f, fmt, v) : snprintf(buf, sizeof(buf), fmt, v); break;
+        case 's': r = f ? fprintf(f, fmt, "hello", "world") : snprintf(buf, sizeof(buf), fmt, "hello", "world"); break;
+        default: r = f ? fprintf(f, fmt, x) : snprintf(buf, sizeof(buf), fmt, x); break;
+      }
+      sink = r;
+    }
+    n += 1000;
+  } while ((elapsed = now() - start) < 0.1);
+  return (double)n / elapsed / 1e6;
+}
+
+int main(void) {
+  static const struct { const char* fmt; int kind; } cases[] = {
+    { "%lld", 'i' },
+    { "%20lld", 'i' },
+    { "%llx", 'i' },
+    { "x=%lld y=%lld\n", 'i' },
+    { "%s, %s!", 's' },
+    { "%f", 'd' },
+    { "%.2f", 'd' },
+    { "%.3e", 'd' },
+    { "%g", 'd' },
+    { "%.17g", 'd' },
+    { "%.40f", 'd' },
+  };
+  // values in a range typical of program output, with a fixed seed
+  uint64_t s = 88172645463325252ull;
+  for (int i = 0; i < 256; i++) {
+    s ^= s << 13, s ^= s >> 7, s ^= s << 17;
+    vals[i] = (double)(s >> 11) / (double)(1ull << 53) * 2000.0 - 1000.0;
+  }
+  FILE* f = fopen("/dev/null", "w");
+  if (!f) {
+    perror("/dev/null");
+    return 1;
+  }
+  printf("%-16s  %10s  %10s  (Mcalls/s)\n", "format", "snprintf", "fprintf");
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    char label[32];
+    snprintf(label, sizeof(label), "\"%s\"", cases[i].fmt);
+    for (char* p = label; *p; p++) {
+      if (*p == '\n')
+        *p = ' ';
+    }
+    printf("%-16s  %10.2f  %10.2f\n", label, run(NULL, cases[i].fmt, cases[i].kind),
+      run(f, cases[i].fmt, cases[i].kind));
+  }
+  return 0;
+}
@@ -0,0 +1,155 @@
+// qsort benchmark: sorts arrays of 4, 8 and 16 byte elements and of string
+// pointers, on random, sorted, reversed and many-duplicates inputs, and
+// prints millions of elements sorted per second. Each result is checked to
+// be sorted. Build it with -DLB_QSORT and llvmbox-tools/llvmboxlib.c to time
+// lb_qsort instead of the libc qsort:
+//   clang-x86_64-linux -O2 test/bench-qsort.c -o bench-qsort
+//   clang-x86_64-linux -O2 -DLB_QSORT test/bench-qsort.c \
+//     llvmbox-tools/llvmboxlib.c -o bench-lb-qsort
+//   ./bench-qsort [nelem]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef LB_QSORT
+  void lb_qsort(void* base, size_t nmemb, size_t width,
+    int(*cmp)(const void* x, const void* y, void* ctx), void* ctx);
+  #define SORT(base, n, width, cmp) lb_qsort((base), (n), (width), (cmp), NULL)
+  #define CMP_ARGS const void* a, const void* b, void* ctx
+#else
+  #define SORT(base, n, width, cmp) qsort((base), (n), (width), (cmp))
+  #define CMP_ARGS const void* a, const void* b
+#endif
+
+typedef struct { uint64_t key, val; } pair_t;
+
+static uint64_t rndstate = 88172645463325252ull;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int cmp_u32(CMP_ARGS) {
+  uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_u64(CMP_ARGS) {
+  uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int cmp_pair(CMP_ARGS) {
+  uint64_t x = ((const pair_t*)a)->key, y = ((const pair_t*)b)->key;
+  return (x > y) - (x < y);
+}
+
+static int cmp_str(CMP_ARGS) {
+  return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+static const struct {
+  const char* name;
+  size_t width;
+  int (*cmp)(CMP_ARGS);
+} types[] = {
+  { "u32", 4, cmp_u32 },
+  { "u64", 8, cmp_u64 },
+  { "pair", 16, cmp_pair },
+  { "string", sizeof(char*), cmp_str },
+};
+#define NTYPES (sizeof(types) / sizeof(types[0]))
+
+static const char* inputs[] = { "random", "sorted", "reversed", "dups" };
+#define NINPUTS (sizeof(inputs) / sizeof(inputs[0]))
+
+static char (*strings)[16];
+
+// key returns the i'th of n keys for input kind
+static uint64_t key(int kind, size_t i, size_t n) {
+  switch (kind) {
+    case 0: return rnd();
+    case 1: return i;
+    case 2: return n - i;
+    default: return rnd() % 16;
+  }
+}
+
+static void fill(void* base, int type, int kind, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    uint64_t k = key(kind, i, n);
+    switch (type) {
+      case 0: ((uint32_t*)base)[i] = (uint32_t)k; break;
+      case 1: ((uint64_t*)base)[i] = k; break;
+      case 2: ((pair_t*)base)[i] = (pair_t){ k, i }; break;
+      default:
+        snprintf(strings[i], sizeof(strings[i]), "%015llu", (unsigned long long)k % 1000000000000000ull);
+        ((char**)base)[i] = strings[i];
+        break;
+    }
+  }
+}
+
+// run sorts a fresh copy of the input until roughly 200 ms have passed and
+// returns millions of elements sorted per second
+static double run(int type, int kind, size_t n, void* src, void* dst) {
+  size_t width = types[type].width;
+  double elapsed = 0;
+  long iters = 0;
+  fill(src, type, kind, n);
+  do {
+    memcpy(dst, src, n * width);
+    double start = now();
+    SORT(dst, n, width, types[type].cmp);
+    elapsed += now() - start;
+    iters++;
+  } while (elapsed < 0.2);
+  for (size_t i = 1; i < n; i++) {
+    #ifdef LB_QSORT
+    int c = types[type].cmp((char*)dst + (i-1)*width, (char*)dst + i*width, NULL);
+    #else
+    int c = types[type].cmp((char*)dst + (i-1)*width, (char*)dst + i*width);
+    #endif
+    if (c > 0) {
+      fprintf(stderr, "%s %s: not sorted at index %zu\n", types[type].name, inputs[kind], i);
+      exit(1);
+    }
+  }
+  return (double)n * (double)iters / elapsed / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+  size_t n = argc > 1 ? (size_t)atol(argv[1]) : 100000;
+  void* src = malloc(n * sizeof(pair_t));
+  void* dst = malloc(n * sizeof(pair_t));
+  strings = malloc(n * sizeof(strings[0]));
+  if (!src || !dst || !strings) {
+    perror("malloc");
+    return 1;
+  }
+  printf("%zu elements (Melements/s)\n%-8s", n, "type");
+  for (size_t k = 0; k < NINPUTS; k++)
+    printf("  %9s", inputs[k]);
+  printf("\n");
+  for (size_t t = 0; t < NTYPES; t++) {
+    printf("%-8s", types[t].name);
+    for (size_t k = 0; k < NINPUTS; k++) {
+      printf("  %9.2f", run((int)t, (int)k, n, src, dst));
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  return 0;
+}
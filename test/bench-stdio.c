@@ -0,0 +1,138 @@
+// stdio locking benchmark: times getc and putc one byte at a time on
+// memory-backed FILEs and prints millions of calls per second for
+//   single      the process has never created a thread
+//   joined      threads were created and have all exited
+//   threaded    another thread is running (each thread uses its own FILE)
+//   N threads   N threads, each using its own FILE
+//   shared      N threads taking turns on one FILE with flockfile
+//   clang-x86_64-linux -O2 test/bench-stdio.c -o bench-stdio
+//   ./bench-stdio [maxthreads [calls-per-thread]]
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BUFSIZE 65536
+
+static long ncalls = 20000000;
+static FILE* shared;
+static pthread_mutex_t idle_mu = PTHREAD_MUTEX_INITIALIZER;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static FILE* memfile(const char* mode) {
+  FILE* f = fmemopen(NULL, BUFSIZE, mode);
+  if (!f) {
+    perror("fmemopen");
+    exit(1);
+  }
+  return f;
+}
+
+static void* getc_worker(void* arg) {
+  FILE* f = memfile("w+");
+  for (int i = 0; i < BUFSIZE; i++)
+    putc('a' + i % 26, f);
+  rewind(f);
+  uintptr_t sum = 0;
+  for (long i = 0; i < ncalls; i++) {
+    int c = getc(f);
+    if (c == EOF) {
+      rewind(f);
+      c = getc(f);
+    }
+    sum += (uintptr_t)c;
+  }
+  fclose(f);
+  return (void*)sum;
+}
+
+static void* putc_worker(void* arg) {
+  FILE* f = memfile("w");
+  for (long i = 0; i < ncalls; i++) {
+    if (putc('x', f) == EOF) {
+      rewind(f);
+      putc('x', f);
+    }
+  }
+  fclose(f);
+  return NULL;
+}
+
+static void* shared_worker(void* arg) {
+  for (long i = 0; i < ncalls; i += 64) {
+    flockfile(shared);
+    for (int j = 0; j < 64; j++) {
+      if (putc_unlocked('x', shared) == EOF)
+        rewind(shared);
+    }
+    funlockfile(shared);
+    putc('y', shared); // locks on its own
+  }
+  return NULL;
+}
+
+static void* idle(void* arg) {
+  pthread_mutex_lock(&idle_mu);
+  pthread_mutex_unlock(&idle_mu);
+  return NULL;
+}
+
+// run runs f on nthreads threads, or on the calling thread if nthreads
+// is 0, and returns millions of calls per second over all threads
+static double run(void* (*f)(void*), int nthreads) {
+  pthread_t threads[256];
+  double start = now();
+  if (nthreads == 0) {
+    f(NULL);
+    nthreads = 1;
+  } else {
+    for (int i = 0; i < nthreads; i++)
+      pthread_create(&threads[i], NULL, f, NULL);
+    for (int i = 0; i < nthreads; i++)
+      pthread_join(threads[i], NULL);
+  }
+  return (double)ncalls * nthreads / (now() - start) / 1e6;
+}
+
+static void report(const char* label, void* (*getc_f)(void*), void* (*putc_f)(void*), int n) {
+  printf("%-12s  %8.1f  %8.1f\n", label, run(getc_f, n), run(putc_f, n));
+}
+
+int main(int argc, char* argv[]) {
+  int maxthreads = argc > 1 ? atoi(argv[1]) : 8;
+  if (argc > 2)
+    ncalls = atol(argv[2]);
+  if (maxthreads > 256)
+    maxthreads = 256;
+
+  printf("%-12s  %8s  %8s  (Mcalls/s)\n", "", "getc", "putc");
+  report("single", getc_worker, putc_worker, 0);
+
+  pthread_t t;
+  pthread_create(&t, NULL, idle, NULL);
+  pthread_join(t, NULL);
+  report("joined", getc_worker, putc_worker, 0);
+
+  pthread_mutex_lock(&idle_mu);
+  pthread_create(&t, NULL, idle, NULL);
+  report("threaded", getc_worker, putc_worker, 0);
+  pthread_mutex_unlock(&idle_mu);
+  pthread_join(t, NULL);
+
+  for (int n = 2; n <= maxthreads; n *= 2) {
+    char label[32];
+    snprintf(label, sizeof(label), "%d threads", n);
+    report(label, getc_worker, putc_worker, n);
+  }
+
+  shared = memfile("w");
+  for (int n = 2; n <= maxthreads; n *= 2)
+    printf("shared %-5d  %8s  %8.1f\n", n, "", run(shared_worker, n));
+  return 0;
+}
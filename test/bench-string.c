@@ -0,0 +1,80 @@
+// String function benchmark: times strlen, strchr, memchr, memcmp and strcmp
+// on sizes from 1 byte to 1 MiB and prints the throughput in GB/s.
+// The match (or terminator) is always at the end, so every byte is examined.
+//   clang-x86_64-linux -O2 test/bench-string.c -o bench-string
+//   ./bench-string [maxsize]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// volatile function pointers keep the compiler from folding or inlining calls
+static size_t (*volatile fn_strlen)(const char*) = strlen;
+static char* (*volatile fn_strchr)(const char*, int) = strchr;
+static void* (*volatile fn_memchr)(const void*, int, size_t) = memchr;
+static int (*volatile fn_memcmp)(const void*, const void*, size_t) = memcmp;
+static int (*volatile fn_strcmp)(const char*, const char*) = strcmp;
+
+static char* a;
+static char* b;
+static volatile uintptr_t sink;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// run calls f for roughly 20 ms and returns the throughput in GB/s
+static double run(int f, size_t size) {
+  // the strings start at an odd offset so that aligned kernels see a head
+  const char* s = a + 1;
+  const char* t = b + 1;
+  long iters = (long)(((size_t)1 << 24) / (size + 16)) + 1, n = 0;
+  double start = now(), elapsed;
+  do {
+    for (long i = 0; i < iters; i++) {
+      uintptr_t r;
+      switch (f) {
+        case 0: r = fn_strlen(s); break;
+        case 1: r = (uintptr_t)fn_strchr(s, 'x'); break;
+        case 2: r = (uintptr_t)fn_memchr(s, 'x', size); break;
+        case 3: r = (uintptr_t)fn_memcmp(s, t, size); break;
+        default: r = (uintptr_t)fn_strcmp(s, t); break;
+      }
+      sink = r;
+    }
+    n += iters;
+  } while ((elapsed = now() - start) < 0.02);
+  return (double)size * (double)n / elapsed / 1e9;
+}
+
+int main(int argc, char* argv[]) {
+  static const char* names[] = { "strlen", "strchr", "memchr", "memcmp", "strcmp" };
+  size_t maxsize = argc > 1 ? (size_t)atol(argv[1]) : (size_t)1 << 20;
+  a = malloc(maxsize + 2);
+  b = malloc(maxsize + 2);
+  if (!a || !b) {
+    perror("malloc");
+    return 1;
+  }
+
+  printf("%8s", "size");
+  for (int f = 0; f < 5; f++)
+    printf("  %8s", names[f]);
+  printf("  (GB/s)\n");
+  for (size_t size = 1; size <= maxsize; size *= 2) {
+    // size-1 filler bytes followed by the byte searched for, then NUL
+    memset(a, 'a', size + 1);
+    a[size] = 'x';
+    a[size + 1] = 0;
+    memcpy(b, a, size + 2);
+    b[size] = 'y';
+    printf("%8zu", size);
+    for (int f = 0; f < 5; f++)
+      printf("  %8.2f", run(f, size));
+    printf("\n");
+  }
+  return 0;
+}
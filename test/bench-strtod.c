@@ -0,0 +1,90 @@
+// strtod benchmark: parses corpora of numbers as they appear in JSON and CSV
+// data and prints millions of numbers and megabytes parsed per second for
+// strtod, strtof and sscanf("%lf").
+//   clang-x86_64-linux -O2 test/bench-strtod.c -o bench-strtod
+//   ./bench-strtod
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUMS 10000
+
+static uint64_t rndstate = 88172645463325252ull;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+static double rndunit(void) {
+  return (double)(rnd() >> 11) / (double)(1ull << 53);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// corpus returns NUMS numbers of one kind, separated by NUL bytes
+static char* corpus(int kind, size_t* size) {
+  char* buf = malloc(NUMS * 48);
+  char* s = buf;
+  for (int i = 0; i < NUMS; i++) {
+    double x = rndunit();
+    switch (kind) {
+      case 0: s += sprintf(s, "%.2f", x * 1000); break;           // prices
+      case 1: s += sprintf(s, "%.6f", x * 360 - 180); break;      // coordinates
+      case 2: s += sprintf(s, "%d", (int)(x * 1e6)); break;       // integers
+      case 3: s += sprintf(s, "%.4e", x * 1e10); break;           // measurements
+      case 4: s += sprintf(s, "%.17g", x * 1e4 - 5e3); break;     // full precision
+      default: s += sprintf(s, "%.25e", x * 1e-100); break;       // long inputs
+    }
+    *s++ = 0;
+  }
+  *size = (size_t)(s - buf);
+  return buf;
+}
+
+static volatile double sink;
+
+// run parses the corpus with function f for roughly 100 ms and returns
+// millions of numbers per second
+static double run(int f, const char* buf, size_t size) {
+  long n = 0;
+  double start = now(), elapsed;
+  do {
+    double sum = 0, d;
+    for (const char* s = buf; s < buf + size; s += strlen(s) + 1) {
+      switch (f) {
+        case 0: sum += strtod(s, NULL); break;
+        case 1: sum += strtof(s, NULL); break;
+        default: sscanf(s, "%lf", &d), sum += d; break;
+      }
+    }
+    sink = sum;
+    n += NUMS;
+  } while ((elapsed = now() - start) < 0.1);
+  return (double)n / elapsed / 1e6;
+}
+
+int main(void) {
+  static const char* names[] = {
+    "prices", "coordinates", "integers", "measurements", "full precision", "long inputs",
+  };
+  printf("%-16s  %8s  %8s  %8s  (Mnumbers/s)\n", "corpus", "strtod", "strtof", "sscanf");
+  for (int k = 0; k < 6; k++) {
+    size_t size;
+    char* buf = corpus(k, &size);
+    double r = run(0, buf, size);
+    printf("%-16s  %8.2f  %8.2f  %8.2f  (strtod %.0f MB/s)\n", names[k], r,
+      run(1, buf, size), run(2, buf, size), r * (double)size / NUMS);
+    free(buf);
+  }
+  return 0;
+}
@@ -0,0 +1,197 @@
+// Differential fuzzer for printf: formats random values with random
+// conversions, flags, widths and precisions and prints a hash of the output
+// for each block of 65536 cases. Build it against two C libraries (e.g. the
+// sysroot before and after a change to vfprintf) and compare what they print;
+// when a block differs, rerun that block with -v to see every case:
+//   clang-x86_64-linux -O2 test/fuzz-printf.c -o fuzz-printf
+//   ./fuzz-printf [-v] [iterations [seed [first]]]
+// Some cases run in a directed rounding mode. Each case is also written
+// through a memory FILE with a small buffer and to a short snprintf buffer,
+// which must give the same text.
+#define _GNU_SOURCE
+#include <fenv.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t rndstate;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+static double rnd_double(void) {
+  static const double special[] = {
+    0.0, -0.0, 0.5, 1.5, 2.5, 0.125, 0.05, 0.15, 0.25, 0.35, 1e22, 1e23,
+    9.5, 99.5, 999.5, 0.95, 0.995, 9.9999995, 5e-324, DBL_MIN, DBL_MAX,
+    DBL_EPSILON, 1.0 / 3, 2.0 / 3, 123456789012345678.0, 0x1p63, 0x1p64,
+    0x1p127, 0x1p128, 1e38, 1e39, 1e-5, 1e-20, 1e-38, 1e300, 1e-300,
+  };
+  union { uint64_t i; double f; } u;
+  double x, p = 1;
+  switch (rnd() % 6) {
+    case 0: // any bit pattern, without inf and nan
+      do
+        u.i = rnd();
+      while ((u.i >> 52 & 0x7ff) == 0x7ff);
+      return u.f;
+    case 1: // short decimals like 12.375 or 0.0625, often exact ties
+      for (int n = (int)(rnd() % 12); n; n--)
+        p *= rnd() & 1 ? 2 : 10;
+      x = (double)(int64_t)(rnd() % 2000001 - 1000000) / p;
+      return rnd() & 1 ? x : x * 0.5;
+    case 2: // integers
+      return (double)(int64_t)(rnd() >> (rnd() % 64));
+    case 3: // next to a power of ten
+      x = 1;
+      for (int n = (int)(rnd() % 40); n; n--)
+        x *= 10;
+      u.f = rnd() & 1 ? x : 1 / x;
+      u.i += (int64_t)(rnd() % 5) - 2;
+      return u.f;
+    case 4: // moderate magnitudes, where the fast paths are taken
+      u.i = rnd() & 0x800fffffffffffffull;
+      u.i |= (uint64_t)(1023 - 70 + rnd() % 140) << 52;
+      return u.f;
+    default:
+      return special[rnd() % (sizeof(special) / sizeof(special[0]))];
+  }
+}
+
+// genfmt writes a random conversion specification to fmt and says which
+// argument it takes: 'i' int, 'l' long long, 'd' double, 'L' long double
+static int genfmt(char* fmt) {
+  static const char flags[] = "-+ #0";
+  static const char fconv[] = "eEfFgGaA";
+  static const char iconv[] = "diouxX";
+  static const char* imods[] = { "", "hh", "h", "l", "ll", "j", "z", "t" };
+  char* s = fmt;
+  int kind;
+  if (rnd() % 4 == 0)
+    *s++ = 'x'; // literal text
+  *s++ = '%';
+  for (int i = 0; i < 5; i++) {
+    if (rnd() % 5 == 0)
+      *s++ = flags[i];
+  }
+  if (rnd() & 1)
+    s += sprintf(s, "%d", (int)(rnd() % 40));
+  switch (rnd() % 4) {
+    case 0: break;
+    case 1: s += sprintf(s, ".%d", (int)(rnd() % 8)); break;
+    case 2: s += sprintf(s, ".%d", (int)(rnd() % 45)); break;
+    default: s += sprintf(s, ".%d", (int)(rnd() % 1100)); break;
+  }
+  if (rnd() % 3) {
+    kind = rnd() % 8 ? 'd' : 'L';
+    if (kind == 'L')
+      *s++ = 'L';
+    *s++ = fconv[rnd() % 8];
+  } else {
+    const char* mod = imods[rnd() % 8];
+    kind = mod[0] == 'l' || mod[0] == 'j' || mod[0] == 'z' || mod[0] == 't' ? 'l' : 'i';
+    s += sprintf(s, "%s%c", mod, iconv[rnd() % 6]);
+  }
+  if (rnd() % 4 == 0)
+    *s++ = '\n';
+  *s = 0;
+  return kind;
+}
+
+static int nfail;
+
+static void fail(const char* what, const char* fmt, uint64_t iter) {
+  fprintf(stderr, "%s: mismatch (format \"%s\", iteration %llu)\n",
+    what, fmt, (unsigned long long)iter);
+  if (++nfail == 20)
+    exit(1);
+}
+
+// put writes s with newlines escaped
+static void put(const char* s, int n) {
+  for (int i = 0; i < n; i++) {
+    if (s[i] == '\n')
+      fputs("\\n", stdout);
+    else
+      putchar(s[i]);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  int verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+  argv += verbose;
+  argc -= verbose;
+  uint64_t iters = argc > 1 ? strtoull(argv[1], NULL, 0) : 1000000;
+  rndstate = argc > 2 ? strtoull(argv[2], NULL, 0) : 88172645463325252ull;
+  uint64_t first = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+  static const int modes[] = { FE_TONEAREST, FE_UPWARD, FE_DOWNWARD, FE_TOWARDZERO };
+  static char buf[2048], buf2[2048], mbuf[2048];
+  char fmt[64], sbuf[16];
+  uint64_t hash = 14695981039346656037ull;
+
+  for (uint64_t it = 0; it < first + iters; it++) {
+    // draw everything before skipping, so that a case does not depend
+    // on where the run starts
+    int kind = genfmt(fmt);
+    double d = rnd_double();
+    long double ld = (long double)d;
+    long long i = (long long)rnd() >> (rnd() % 64);
+    int mode = rnd() % 8 == 0 ? 1 + (int)(rnd() % 3) : 0;
+    int lbf = rnd() & 1;
+    size_t cap = rnd() % 40;
+    if (kind == 'L' && (rnd() & 1)) // use the extra precision, if any
+      ld += (long double)d * LDBL_EPSILON * (long double)(rnd() % 1000);
+    if (it < first)
+      continue;
+    if (it % 65536 == 0)
+      hash = 14695981039346656037ull;
+
+#define FORMAT(fn, ...) \
+  (kind == 'i' ? fn(__VA_ARGS__, (int)i) \
+   : kind == 'l' ? fn(__VA_ARGS__, i) \
+   : kind == 'd' ? fn(__VA_ARGS__, d) \
+   : fn(__VA_ARGS__, ld))
+
+    fesetround(modes[mode]);
+    int n = FORMAT(snprintf, buf, sizeof(buf), fmt);
+
+    // the same through a FILE with a small buffer
+    FILE* f = fmemopen(mbuf, sizeof(mbuf), "w");
+    setvbuf(f, sbuf, lbf ? _IOLBF : _IOFBF, sizeof(sbuf));
+    int n2 = FORMAT(fprintf, f, fmt);
+    fflush(f);
+    long pos = ftell(f);
+    fclose(f);
+    if (n2 != n || pos != n || memcmp(mbuf, buf, n > 0 ? n : 0) != 0)
+      fail("fprintf", fmt, it);
+
+    // truncated output must be a prefix of the full output
+    int n3 = FORMAT(snprintf, buf2, cap, fmt);
+    if (n3 != n || (cap && (strlen(buf2) != (n < (int)cap ? (size_t)n : cap - 1) ||
+                            memcmp(buf2, buf, strlen(buf2)) != 0)))
+      fail("snprintf truncation", fmt, it);
+    fesetround(FE_TONEAREST);
+
+    if (verbose) {
+      printf("%llu %d ", (unsigned long long)it, mode);
+      put(fmt, (int)strlen(fmt));
+      printf(" %d ", n);
+      put(buf, n > 0 ? n : 0);
+      printf("\n");
+    }
+
+    // FNV-1a over the rounding mode, the length and the text
+    hash = (hash ^ (uint64_t)(n * 4 + mode)) * 1099511628211ull;
+    for (int j = 0; j < n; j++)
+      hash = (hash ^ (unsigned char)buf[j]) * 1099511628211ull;
+    if (!verbose && ((it + 1) % 65536 == 0 || it + 1 == first + iters))
+      printf("%llu %016llx\n", (unsigned long long)(it - it % 65536), (unsigned long long)hash);
+  }
+  return nfail != 0;
+}
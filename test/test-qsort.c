@@ -0,0 +1,177 @@
+// Randomized test of qsort_r with consistent and inconsistent comparison
+// functions. A consistent one (that may call many elements equal) must sort;
+// one that returns random results, always -1 or 1, or orders three values in a
+// cycle, need not, but qsort must still only compare elements of the array,
+// leave it a permutation of its input and not write outside it, which the
+// guard bytes on either side check. Build it with -DLB_QSORT and
+// llvmbox-tools/llvmboxlib.c to test lb_qsort instead of the libc qsort_r:
+//   clang-x86_64-linux -O2 test/test-qsort.c -o test-qsort
+//   clang-x86_64-linux -O2 -DLB_QSORT test/test-qsort.c \
+//     llvmbox-tools/llvmboxlib.c -o test-lb-qsort
+//   ./test-qsort [iterations [seed]]
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef LB_QSORT
+  void lb_qsort(void* base, size_t nmemb, size_t width,
+    int(*cmp)(const void* x, const void* y, void* ctx), void* ctx);
+  #define SORT lb_qsort
+#else
+  #define SORT qsort_r
+#endif
+
+#define MAXN   2000
+#define MAXW   24
+#define GUARD  256 // bytes on either side of the array
+#define GUARDC 0xa5
+
+enum { CMP_GOOD, CMP_RANDOM, CMP_LESS, CMP_GREATER, CMP_CYCLE, CMP_COUNT };
+
+static const char* const cmpname[CMP_COUNT] = {
+  "consistent", "random", "always -1", "always 1", "cyclic",
+};
+
+typedef struct {
+  unsigned char* base;
+  size_t         n, width;
+  int            kind;
+  unsigned       shift; // CMP_GOOD compares values >> shift
+  uint64_t       ncmp, maxcmp;
+} sortctx_t;
+
+static unsigned char buf[GUARD + MAXN*MAXW + 8 + GUARD];
+static unsigned char seen[MAXN];
+
+static uint64_t rndstate;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+// Each element starts with its value, a 32-bit index into the input, and is
+// padded with bytes derived from it, so that a torn swap is noticed.
+static void put(unsigned char* p, size_t width, uint32_t v) {
+  memcpy(p, &v, 4);
+  for (size_t i = 4; i < width; i++)
+    p[i] = (unsigned char)(v*7 + i);
+}
+
+static uint32_t get(const unsigned char* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static int cmp(const void* a, const void* b, void* ctxp) {
+  sortctx_t* ctx = ctxp;
+  const unsigned char* x = a;
+  const unsigned char* y = b;
+  size_t size = ctx->n * ctx->width;
+  if (x < ctx->base || x >= ctx->base + size || (size_t)(x - ctx->base) % ctx->width ||
+      y < ctx->base || y >= ctx->base + size || (size_t)(y - ctx->base) % ctx->width)
+  {
+    fprintf(stderr, "%s cmp called with %+td, %+td outside the array [0,%zu)"
+      " of %zu byte elements\n", cmpname[ctx->kind],
+      x - ctx->base, y - ctx->base, size, ctx->width);
+    exit(1);
+  }
+  if (++ctx->ncmp > ctx->maxcmp) {
+    fprintf(stderr, "%s cmp called more than %llu times for %zu elements\n",
+      cmpname[ctx->kind], (unsigned long long)ctx->maxcmp, ctx->n);
+    exit(1);
+  }
+  uint32_t u = get(x), v = get(y);
+  switch (ctx->kind) {
+    case CMP_GOOD:    u >>= ctx->shift; v >>= ctx->shift; return (u > v) - (u < v);
+    case CMP_RANDOM:  return (int)(rnd() % 3) - 1;
+    case CMP_LESS:    return -1;
+    case CMP_GREATER: return 1;
+    default:
+      // x < y if y is one past x modulo 3, so that x < y < z < x
+      return u % 3 == v % 3 ? 0 : (u + 1) % 3 == v % 3 ? -1 : 1;
+  }
+}
+
+static int nfail;
+
+static void fail(const char* what, const sortctx_t* ctx, uint64_t iter) {
+  fprintf(stderr, "%s: %s (%zu elements of %zu bytes, iteration %llu)\n",
+    cmpname[ctx->kind], what, ctx->n, ctx->width, (unsigned long long)iter);
+  if (++nfail == 20)
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+  static const size_t widths[] = { 4, 8, 12, 16, 24 };
+  uint64_t iters = argc > 1 ? strtoull(argv[1], NULL, 0) : 20000;
+  rndstate = argc > 2 ? strtoull(argv[2], NULL, 0) : 88172645463325252ull;
+
+  for (uint64_t it = 0; it < iters; it++) {
+    sortctx_t ctx = { 0 };
+    ctx.width = widths[rnd() % (sizeof(widths) / sizeof(widths[0]))];
+    ctx.n = rnd() % ((it & 3) ? 64 : MAXN + 1);
+    ctx.kind = (int)(rnd() % CMP_COUNT);
+    ctx.shift = rnd() % 3 ? 0 : (unsigned)(rnd() % 12);
+    ctx.maxcmp = 2*(uint64_t)ctx.n*ctx.n + 1000;
+    // misaligned by 4 bytes half of the time, for the bytewise swap
+    ctx.base = buf + GUARD + (rnd() & 1) * 4;
+    size_t w = ctx.width, n = ctx.n;
+
+    // sorted, reversed, almost sorted or random input
+    int pattern = (int)(rnd() % 4);
+    for (size_t i = 0; i < n; i++)
+      put(ctx.base + i*w, w, (uint32_t)(pattern == 1 ? n - 1 - i : i));
+    if (n && pattern >= 2) {
+      size_t nswap = pattern == 2 ? 1 + n/64 : n;
+      unsigned char tmp[MAXW];
+      for (size_t i = 0; i < nswap; i++) {
+        unsigned char* a = ctx.base + (pattern == 2 ? rnd() % n : i)*w;
+        unsigned char* b = ctx.base + (rnd() % n)*w;
+        memcpy(tmp, a, w);
+        memcpy(a, b, w);
+        memcpy(b, tmp, w);
+      }
+    }
+    memset(buf, GUARDC, (size_t)(ctx.base - buf));
+    memset(ctx.base + n*w, GUARDC, (size_t)(buf + sizeof(buf) - (ctx.base + n*w)));
+
+    SORT(ctx.base, n, w, cmp, &ctx);
+
+    for (unsigned char* p = buf; p < buf + sizeof(buf); p++) {
+      if (p == ctx.base)
+        p += n*w;
+      if (p < buf + sizeof(buf) && *p != GUARDC) {
+        fail("wrote outside the array", &ctx, it);
+        break;
+      }
+    }
+    memset(seen, 0, n);
+    for (size_t i = 0; i < n; i++) {
+      const unsigned char* p = ctx.base + i*w;
+      uint32_t v = get(p);
+      int torn = v >= n || seen[v]++;
+      for (size_t j = 4; j < w && !torn; j++)
+        torn = p[j] != (unsigned char)(v*7 + j);
+      if (torn) {
+        fail("result is not a permutation of the input", &ctx, it);
+        break;
+      }
+      if (ctx.kind == CMP_GOOD && i && (get(p - w) >> ctx.shift) > (v >> ctx.shift)) {
+        fail("result is not sorted", &ctx, it);
+        break;
+      }
+    }
+  }
+
+  if (nfail)
+    return 1;
+  printf("ok (%llu iterations)\n", (unsigned long long)iters);
+  return 0;
+}
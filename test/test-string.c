@@ -0,0 +1,230 @@
+// Randomized differential test of the string functions: compares strlen,
+// strnlen, strchr, strchrnul, strrchr, memchr, memcmp, strcmp, strncmp,
+// memcpy, memmove and memset of the C library against plain byte-at-a-time
+// versions. Strings are placed at random offsets, often right before a
+// PROT_NONE page, so that reading past the end of a string crashes the test.
+// -fno-builtin keeps the compiler from expanding calls inline:
+//   clang-aarch64-linux -O2 -fno-builtin test/test-string.c -o test-string
+//   ./test-string [iterations [seed]]
+// On x86_64, also run it with a low threshold for non-temporal stores, e.g.
+// MUSL_MEMCPY_NT_THRESHOLD=1024, to cover those paths of memcpy, memmove and
+// memset: one in four copies and fills is up to AREA-1 (8191) bytes long.
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define PAGE 4096
+#define AREA (2 * PAGE) // usable bytes before the guard page
+
+static size_t ref_strlen(const char* s) {
+  size_t n = 0;
+  while (s[n])
+    n++;
+  return n;
+}
+
+static size_t ref_strnlen(const char* s, size_t max) {
+  size_t n = 0;
+  while (n < max && s[n])
+    n++;
+  return n;
+}
+
+static char* ref_strchrnul(const char* s, int c) {
+  while (*s && *(unsigned char*)s != (unsigned char)c)
+    s++;
+  return (char*)s;
+}
+
+static char* ref_strchr(const char* s, int c) {
+  char* p = ref_strchrnul(s, c);
+  return *(unsigned char*)p == (unsigned char)c ? p : NULL;
+}
+
+static char* ref_strrchr(const char* s, int c) {
+  const char* r = NULL;
+  do {
+    if (*(unsigned char*)s == (unsigned char)c)
+      r = s;
+  } while (*s++);
+  return (char*)r;
+}
+
+static void* ref_memchr(const void* p, int c, size_t n) {
+  const unsigned char* s = p;
+  for (; n; n--, s++) {
+    if (*s == (unsigned char)c)
+      return (void*)s;
+  }
+  return NULL;
+}
+
+static int ref_memcmp(const void* a, const void* b, size_t n) {
+  const unsigned char *l = a, *r = b;
+  for (; n && *l == *r; n--, l++, r++) {}
+  return n ? *l - *r : 0;
+}
+
+static int ref_strncmp(const char* a, const char* b, size_t n) {
+  const unsigned char *l = (const void*)a, *r = (const void*)b;
+  for (; n && *l == *r && *l; n--, l++, r++) {}
+  return n ? *l - *r : 0;
+}
+
+// ref_memmove copies through a temporary buffer, which handles any overlap
+static void ref_memmove(unsigned char* d, const unsigned char* s, size_t n) {
+  static unsigned char tmp[AREA];
+  for (size_t i = 0; i < n; i++)
+    tmp[i] = s[i];
+  for (size_t i = 0; i < n; i++)
+    d[i] = tmp[i];
+}
+
+static int sign(int x) {
+  return (x > 0) - (x < 0);
+}
+
+static uint64_t rndstate;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+// guarded returns AREA writable bytes followed by an inaccessible page
+static unsigned char* guarded(void) {
+  unsigned char* p = mmap(NULL, AREA + PAGE, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED || mprotect(p + AREA, PAGE, PROT_NONE) != 0) {
+    perror("mmap");
+    exit(1);
+  }
+  return p;
+}
+
+static int nfail;
+static unsigned char shadow[AREA];
+
+static void fail(const char* fn, size_t len, size_t off, uint64_t iter) {
+  fprintf(stderr, "%s: mismatch (len %zu, offset %zu, iteration %llu)\n",
+    fn, len, off, (unsigned long long)iter);
+  if (++nfail == 20)
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+  uint64_t iters = argc > 1 ? strtoull(argv[1], NULL, 0) : 1000000;
+  rndstate = argc > 2 ? strtoull(argv[2], NULL, 0) : 88172645463325252ull;
+  unsigned char* abuf = guarded();
+  unsigned char* bbuf = guarded();
+
+  for (uint64_t it = 0; it < iters; it++) {
+    // mostly short strings; sometimes up to almost two pages
+    size_t len = rnd() % ((it & 3) ? 80 : AREA - 1);
+    size_t aoff = AREA - len - 1, boff = aoff;
+    if (rnd() & 1)
+      aoff = rnd() % (AREA - len);
+    if (rnd() & 1)
+      boff = rnd() % (AREA - len);
+    unsigned char* a = abuf + aoff;
+    unsigned char* b = bbuf + boff;
+
+    // a small alphabet makes matches likely; bytes >= 0x80 test signedness
+    int alphabet = 1 + (int)(rnd() % 4);
+    for (size_t i = 0; i < len; i++)
+      a[i] = (unsigned char)('a' + rnd() % alphabet);
+    if (len && rnd() % 3 == 0)
+      a[rnd() % len] = (unsigned char)(0x80 + rnd() % 128);
+    a[len] = 0;
+    memcpy(b, a, len + 1);
+    if (len && (rnd() & 1))
+      b[rnd() % len] = (unsigned char)(rnd() % 4 ? rnd() : 0);
+
+    int c = 'a' + (int)(rnd() % 5);
+    if (rnd() % 8 == 0)
+      c = rnd() % 4 ? (int)(0x80 + rnd() % 128) : 0;
+    if (rnd() & 1)
+      c |= 0x100; // only the low byte counts
+    size_t n = rnd() % (len + 2);
+    const char *s = (const char*)a, *t = (const char*)b;
+
+    if (strlen(s) != ref_strlen(s))
+      fail("strlen", len, aoff, it);
+    if (strnlen(s, n) != ref_strnlen(s, n))
+      fail("strnlen", n, aoff, it);
+    if (strchr(s, c) != ref_strchr(s, c))
+      fail("strchr", len, aoff, it);
+    if (strchrnul(s, c) != ref_strchrnul(s, c))
+      fail("strchrnul", len, aoff, it);
+    if (strrchr(s, c) != ref_strrchr(s, c))
+      fail("strrchr", len, aoff, it);
+    if (memchr(a, c, n) != ref_memchr(a, c, n))
+      fail("memchr", n, aoff, it);
+    if (sign(memcmp(a, b, n)) != sign(ref_memcmp(a, b, n)))
+      fail("memcmp", n, aoff, it);
+    if (sign(memcmp(a, b, len + 1)) != sign(ref_memcmp(a, b, len + 1)))
+      fail("memcmp", len + 1, aoff, it);
+    if (sign(strcmp(s, t)) != sign(ref_strncmp(s, t, SIZE_MAX)) ||
+        sign(strcmp(t, s)) != sign(ref_strncmp(t, s, SIZE_MAX)))
+      fail("strcmp", len, aoff, it);
+    if (sign(strncmp(s, t, n)) != sign(ref_strncmp(s, t, n)))
+      fail("strncmp", n, aoff, it);
+
+    // memcpy, memmove and memset write to b, and the same edits are made
+    // to a shadow copy of b; compare them around the written range.
+    // memmove moves within b by a small or a random distance.
+    n = rnd() % ((it & 3) ? 300 : AREA);
+    size_t dst = rnd() % (AREA - n), src = rnd() % (AREA - n);
+    if (rnd() & 1) {
+      size_t dist = rnd() % 70;
+      src = (rnd() & 1) ? dst + dist : dst - dist;
+      if (src > AREA - n)
+        src = dst;
+    }
+    size_t lo = dst < 64 ? 0 : dst - 64;
+    size_t hi = AREA - dst - n < 64 ? AREA : dst + n + 64;
+    for (size_t i = lo; i < hi; i++)
+      shadow[i] = bbuf[i];
+    const char* fn;
+    switch (it % 3) {
+      case 0:
+        fn = "memcpy";
+        memcpy(bbuf + dst, abuf + src, n);
+        ref_memmove(shadow + dst, abuf + src, n);
+        break;
+      case 1:
+        fn = "memmove";
+        for (size_t i = src; i < src + n; i++)
+          shadow[i] = bbuf[i];
+        memmove(bbuf + dst, bbuf + src, n);
+        ref_memmove(shadow + dst, shadow + src, n);
+        break;
+      default:
+        fn = "memset";
+        memset(bbuf + dst, c, n);
+        for (size_t i = 0; i < n; i++)
+          shadow[dst + i] = (unsigned char)c;
+        break;
+    }
+    for (size_t i = lo; i < hi; i++) {
+      if (bbuf[i] != shadow[i]) {
+        fail(fn, n, dst, it);
+        break;
+      }
+    }
+    // vary the bytes that the next copies read
+    for (size_t i = 0; i < 16; i++)
+      abuf[rnd() % AREA] = (unsigned char)rnd();
+  }
+
+  if (nfail)
+    return 1;
+  printf("ok (%llu iterations)\n", (unsigned long long)iters);
+  return 0;
+}
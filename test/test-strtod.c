@@ -0,0 +1,188 @@
+// Randomized test of strtod, strtof and strtold. It checks that printed
+// doubles and floats read back to the same value, and that values exactly
+// halfway between two neighbouring doubles or floats round to the even one,
+// or to the nearer one when a digit is appended. It also parses random decimal
+// strings and prints a hash of the results for each block of 65536 cases.
+// Build it against two C libraries (e.g. before and after a change to
+// floatscan) and compare what they print; rerun a block with -v to see every
+// case. With -f, it reads back every float (or every stride'th) instead.
+//   clang-x86_64-linux -O2 test/test-strtod.c -o test-strtod
+//   ./test-strtod [-v] [iterations [seed [first]]]
+//   ./test-strtod -f [stride]
+#include <errno.h>
+#include <float.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t rndstate;
+
+static uint64_t rnd(void) {
+  // xorshift64
+  rndstate ^= rndstate << 13;
+  rndstate ^= rndstate >> 7;
+  rndstate ^= rndstate << 17;
+  return rndstate;
+}
+
+static int nfail;
+
+static void fail(const char* what, const char* s, uint64_t iter) {
+  fprintf(stderr, "%s: wrong result for \"%s\" (iteration %llu)\n",
+    what, s, (unsigned long long)iter);
+  if (++nfail == 20)
+    exit(1);
+}
+
+static uint64_t dbits(double x) {
+  uint64_t i;
+  memcpy(&i, &x, 8);
+  return i;
+}
+
+static double dfrom(uint64_t i) {
+  double x;
+  memcpy(&x, &i, 8);
+  return x;
+}
+
+static uint32_t fbits(float x) {
+  uint32_t i;
+  memcpy(&i, &x, 4);
+  return i;
+}
+
+static float ffrom(uint32_t i) {
+  float x;
+  memcpy(&x, &i, 4);
+  return x;
+}
+
+// gendec writes a random decimal number to s: up to 25 digits, often with
+// leading or trailing zeros, a radix point and an exponent
+static void gendec(char* s) {
+  int ndig = 1 + (int)(rnd() % (rnd() % 4 ? 19 : 25));
+  int point = rnd() % 3 ? (int)(rnd() % (ndig + 1)) : -1;
+  if (rnd() % 4 == 0)
+    *s++ = rnd() & 1 ? '-' : '+';
+  for (int n = rnd() % 4 == 0 ? (int)(rnd() % 4) : 0; n; n--)
+    *s++ = '0';
+  for (int i = 0; i < ndig; i++) {
+    if (i == point)
+      *s++ = '.';
+    *s++ = (char)('0' + (rnd() % 8 == 0 ? 0 : rnd() % 10));
+  }
+  if (point == ndig)
+    *s++ = '.';
+  if (rnd() & 1) {
+    int e = rnd() % 4 ? (int)(rnd() % 61) - 30 : (int)(rnd() % 701) - 350;
+    s += sprintf(s, "%c%d", rnd() & 1 ? 'e' : 'E', e);
+  }
+  *s = 0;
+}
+
+static int all_floats(uint32_t stride) {
+  char buf[64];
+  for (uint64_t i = 0; i < 0x7f800000; i += stride) {
+    float x = ffrom((uint32_t)i);
+    snprintf(buf, sizeof(buf), "%.9g", x);
+    if (fbits(strtof(buf, NULL)) != (uint32_t)i)
+      fail("strtof", buf, i);
+    snprintf(buf, sizeof(buf), "%.17g", (double)x);
+    if (fbits(strtof(buf, NULL)) != (uint32_t)i)
+      fail("strtof", buf, i);
+  }
+  if (nfail)
+    return 1;
+  printf("ok (floats with stride %u)\n", stride);
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && strcmp(argv[1], "-f") == 0)
+    return all_floats(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1);
+  int verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+  argv += verbose;
+  argc -= verbose;
+  uint64_t iters = argc > 1 ? strtoull(argv[1], NULL, 0) : 1000000;
+  rndstate = argc > 2 ? strtoull(argv[2], NULL, 0) : 88172645463325252ull;
+  uint64_t first = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+  uint64_t hash = 14695981039346656037ull;
+  char s[128], t[128];
+
+  for (uint64_t it = 0; it < first + iters; it++) {
+    // draw everything before skipping, so that a case does not depend
+    // on where the run starts
+    uint64_t r = rnd(), r2 = rnd();
+    gendec(s);
+    if (it < first)
+      continue;
+    if (it % 65536 == 0)
+      hash = 14695981039346656037ull;
+
+    // any finite double reads back from 17 digits, any float from 9
+    double x = dfrom(r & 0xffefffffffffffffull);
+    snprintf(t, sizeof(t), "%.17g", x);
+    if (dbits(strtod(t, NULL)) != dbits(x))
+      fail("strtod", t, it);
+    float fx = ffrom((uint32_t)r & 0xff7fffff);
+    snprintf(t, sizeof(t), "%.9g", fx);
+    if (fbits(strtof(t, NULL)) != fbits(fx))
+      fail("strtof", t, it);
+
+    // x = m*2^e with m of 53 bits and a halfway point that is an integer
+    // of up to 19 digits; appending a digit moves it off the halfway point
+    uint64_t m = (r2 | 1ull << 52) & ((1ull << 53) - 1);
+    int e = 1 + (int)(r2 >> 53) % 10;
+    uint64_t mid = (m << e) + (1ull << (e - 1));
+    double lo = (double)(m << e), hi = dfrom(dbits(lo) + 1);
+    snprintf(t, sizeof(t), "%llu", (unsigned long long)mid);
+    if (strtod(t, NULL) != (m & 1 ? hi : lo))
+      fail("strtod", t, it);
+    snprintf(t, sizeof(t), "%llu1e-1", (unsigned long long)mid);
+    if (strtod(t, NULL) != hi)
+      fail("strtod", t, it);
+    snprintf(t, sizeof(t), "%llu9e-1", (unsigned long long)mid - 1);
+    if (strtod(t, NULL) != lo)
+      fail("strtod", t, it);
+    // the same for floats, with m of 24 bits
+    uint32_t fm = (uint32_t)(m >> 29);
+    e = 1 + (int)(r2 >> 53) % 30;
+    mid = ((uint64_t)fm << e) + (1ull << (e - 1));
+    float flo = (float)((uint64_t)fm << e), fhi = ffrom(fbits(flo) + 1);
+    snprintf(t, sizeof(t), "%llu", (unsigned long long)mid);
+    if (strtof(t, NULL) != (fm & 1 ? fhi : flo))
+      fail("strtof", t, it);
+    snprintf(t, sizeof(t), "%llu1e-1", (unsigned long long)mid);
+    if (strtof(t, NULL) != fhi)
+      fail("strtof", t, it);
+    snprintf(t, sizeof(t), "%llu9e-1", (unsigned long long)mid - 1);
+    if (strtof(t, NULL) != flo)
+      fail("strtof", t, it);
+
+    // random decimal strings: hash the results, the end and errno, and
+    // check that sscanf agrees with strtod
+    char* end;
+    errno = 0;
+    double d = strtod(s, &end);
+    int err = errno;
+    float f = strtof(s, NULL);
+    long double ld = strtold(s, NULL);
+    double d2;
+    if (sscanf(s, "%lf", &d2) != 1 || dbits(d2) != dbits(d))
+      fail("sscanf", s, it);
+    if (verbose)
+      printf("%llu %s %a %a %La %d\n", (unsigned long long)it, s, d, (double)f, ld, err);
+    uint64_t v[4] = { dbits(d), fbits(f), (uint64_t)(end - s), (uint64_t)err };
+    for (int i = 0; i < 4; i++)
+      hash = (hash ^ v[i]) * 1099511628211ull;
+    unsigned char lb[sizeof(long double)] = { 0 };
+    memcpy(lb, &ld, LDBL_MANT_DIG == 64 ? 10 : sizeof(ld));
+    for (size_t i = 0; i < sizeof(lb); i++)
+      hash = (hash ^ lb[i]) * 1099511628211ull;
+    if (!verbose && ((it + 1) % 65536 == 0 || it + 1 == first + iters))
+      printf("%llu %016llx\n", (unsigned long long)(it - it % 65536), (unsigned long long)hash);
+  }
+  return nfail != 0;
+}
@@ -425,6 +425,16 @@ _gen_buildfile() { # <arch> <sys> [<sysver>]
     wasi) triple=$arch-unknown-wasi ;;
   esac
   local target=$arch-$sys; [ -n "$sysver" ] && target=$target.$sysver
+
+  # The builtins don't depend on the OS version, so like compiler-rt's own
+  # libclang_rt.osx.a, we compile them for the oldest supported version.
+  # This makes the objects of all macos.N targets of an arch the same, so that
+  # only the first one built is compiled; the others are objcache hits.
+  local cc_sysver=$sysver cc_triple=$triple
+  if [ "$sys" = macos ]; then
+    cc_sysver=10; [ "$arch" = aarch64 ] && cc_sysver=11
+    cc_triple=$arch-apple-darwin$(( cc_sysver + 9 ))
+  fi
   # echo "arch=$arch sys=$sys sysver=$sysver triple=$triple"
 
   local BF="build-$target.ninja"
@@ -433,7 +443,7 @@ _gen_buildfile() { # <arch> <sys> [<sysver>]
 
   # see compiler-rt/lib/builtins/CMakeLists.txt
   local CFLAGS=(
-    -std=c11 -nostdinc -Os --target=$triple \
+    -std=c11 -nostdinc -Os --target=$cc_triple \
     -fPIC \
     -fno-builtin \
     -fomit-frame-pointer \
@@ -444,10 +454,12 @@ _gen_buildfile() { # <arch> <sys> [<sysver>]
   # note: lib/clang/$LLVM_RELEASE/include contains headers for all supported archs
 
   # system and libc headers
-  [ -n "$sysver" ] &&
-    CFLAGS+=( -I../../targets/$arch-$sys.$sysver/include )
+  [ -n "$cc_sysver" ] &&
+    CFLAGS+=( -I../../targets/$arch-$sys.$cc_sysver/include )
   CFLAGS+=( -I../../targets/$arch-$sys/include )
   CFLAGS+=( -I../../targets/any-$sys/include )
+  # objcache: the target include dirs are made from all $sys sysroots/include dirs
+  local HDRHASH=$(_objcache_hdrhash . "$SYSROOTS_DIR"/include/*-$sys*)
   # for f in ${CFLAGS[@]}; do echo $f; done
 
   # TODO: $COMPILER_RT_HAS_FLOAT16 && CFLAGS+=( -DCOMPILER_RT_HAS_FLOAT16 )
@@ -474,12 +486,14 @@ _gen_buildfile() { # <arch> <sys> [<sysver>]
 cflags = ${CFLAGS[@]}
 libdir = ../../targets/$target/lib
 obj = /tmp/llvmbox-$LLVM_RELEASE+$LLVMBOX_VERSION_TAG-rt-$target
+builddir = \$obj
+objcache = $(_objcache_dir)
 rule cc
-  command = ../../bin/clang -MMD -MF \$out.d \$cflags \$flags -c -o \$out \$in
+  command = $(_objcache_cc_command)
   depfile = \$out.d
   description = cc \$in -> \$out
 rule ar
-  command = rm -f \$out && ../../bin/ar crs \$out \$in
+  command = rm -f \$out.tmp && ../../bin/ar crs \$out.tmp \$in && mv -f \$out.tmp \$out
   description = archive \$out
 END
 
@@ -496,6 +510,7 @@ END
     obj=\$obj/${f/%.[csS]/.o}
     objects+=( "$obj" )
     echo "build $obj: cc $f" >> $BF
+    echo "  key = $(_objcache_key "$f" "$HDRHASH" "${CFLAGS[@]}")" >> $BF
   done
 
   echo "build \$libdir/librt.a: ar ${objects[@]}" >> $BF
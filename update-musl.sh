@@ -11,6 +11,13 @@ _fetch_source_tar \
 
 _pushd "$MUSL_SRC"
 
+# apply patches (patches/musl-VERSION-NNN-name.patch, in order)
+for f in "$PROJECT"/patches/musl-$MUSL_VERSION-*.patch; do
+  [ -f "$f" ] || continue
+  echo "patch -p1 < $(_relpath "$f")"
+  patch -p1 < "$f"
+done
+
 # ————————————————————————————————————————————————————————————————————————————————————
 # copy headers
 for arch in "${SUPPORTED_ARCHS[@]}"; do
@@ -37,6 +44,7 @@ for f in \
   ldso/*.c \
   src/*/*.c \
   src/malloc/mallocng/*.c \
+  src/malloc/fast/*.c \
 ;do
   [ -f "$f" ] || continue
   mkdir -p $(dirname "$SOURCE_DESTDIR/$f")
@@ -87,6 +95,14 @@ rm -rf "$MUSL_SRC"
 # We generate empty libs so that e.g. -lm doesn't fail.
 EMPTY_LIBS=( m pthread crypt util xnet resolv dl )
 
+# "hot core" of libc (src/ dirs); enough to link most programs.
+# clang-TARGET builds this first (ninja target libc-core) and the complete
+# libc.a in the background.
+LIBC_CORE_DIRS=(
+  internal env errno exit ldso malloc mman stdio string thread unistd stdlib \
+  ctype locale multibyte signal time \
+)
+
 _pushd "$SOURCE_DESTDIR"
 
 _cc_rule() { # <src> <obj> [<flag> ...]
@@ -119,6 +135,7 @@ _cc_rule() { # <src> <obj> [<flag> ...]
   if [ ${#flags[@]} -gt 0 ]; then
     echo "  flags = ${flags[@]}"
   fi
+  echo "  key = $(_objcache_key "$src" "$HDRHASH" "${CFLAGS[@]}" "${flags[@]}")"
 }
 
 _gen_buildfile() { # <arch>
@@ -128,7 +145,8 @@ _gen_buildfile() { # <arch>
   local LIBC_OBJECTS=()
   local LIBC_SOURCES=()
   local ALL_TARGETS=()
-  local f name src obj exclude af_name
+  local LIBC_CORE_OBJECTS=()
+  local f name src obj exclude af_name dir
 
   echo "generating $(_relpath "$PWD/$BF")"
 
@@ -160,6 +178,9 @@ _gen_buildfile() { # <arch>
     -I../../targets/$arch-linux/include \
     -I../../targets/any-linux/include \
   )
+  # objcache: the target include dirs are made from all linux sysroots/include dirs
+  local HDRHASH=$(_objcache_hdrhash arch/$arch arch/generic src/include src/internal \
+                  "$SYSROOTS_DIR"/include/*-linux*)
 
   # find sources
   for f in \
@@ -201,16 +222,19 @@ _gen_buildfile() { # <arch>
 cflags = ${CFLAGS[@]}
 libdir = ../../targets/$arch-linux/lib
 obj = /tmp/llvmbox-$LLVM_RELEASE+$LLVMBOX_VERSION_TAG-musl-$arch
+builddir = \$obj
+objcache = $(_objcache_dir)
 rule cc
-  command = ../../bin/clang -MMD -MF \$out.d \$cflags \$flags -c -o \$out \$in
+  command = $(_objcache_cc_command)
   depfile = \$out.d
   description = cc \$in -> \$out
 rule ar
-  command = rm -f \$out && ../../bin/ar crs \$out \$in
+  command = rm -f \$out.tmp && ../../bin/ar crs \$out.tmp \$in && mv -f \$out.tmp \$out
   description = archive \$out
 END
 
   # crt (C runtime) objects
+  local CRT_OBJECTS=()
   printf "\n# crt\n" >> $BF
   for name in crt1 rcrt1 Scrt1 crti crtn; do
     src=crt/$arch/$name.s
@@ -219,6 +243,7 @@ END
     obj=\$libdir/$name.o
     flags=; [ $name = rcrt1 -o $name = Scrt1 ] && flags=-fPIC
     _cc_rule "$src" "$obj" -DCRT $flags >> $BF
+    CRT_OBJECTS+=( "$obj" )
     ALL_TARGETS+=( "$obj" )
   done
 
@@ -227,17 +252,41 @@ END
   for src in ${LIBC_SOURCES[@]}; do
     obj="\$obj/${src}.o"
     LIBC_OBJECTS+=( "$obj" )
+    dir=${src#src/}; dir=${dir%%/*}
+    [[ " ${LIBC_CORE_DIRS[*]} " != *" $dir "* ]] || LIBC_CORE_OBJECTS+=( "$obj" )
     _cc_rule "$src" "$obj" -fPIC >> $BF
   done
-  echo "build \$libdir/libc.a: ar ${LIBC_OBJECTS[@]}" >> $BF
+  # libc.a is built after crt objects; clang-TARGET uses its presence to mean
+  # "libc is complete"
+  echo "build \$libdir/libc.a: ar ${LIBC_OBJECTS[@]} || ${CRT_OBJECTS[@]}" >> $BF
   ALL_TARGETS+=( "\$libdir/libc.a" )
 
   # empty libs
+  local EMPTY_LIB_TARGETS=()
   printf "\n# empty libs\n" >> $BF
   for name in "${EMPTY_LIBS[@]}"; do
     echo "build \$libdir/lib$name.a: ar" >> $BF
-    ALL_TARGETS+=( "\$libdir/lib$name.a" )
+    EMPTY_LIB_TARGETS+=( "\$libdir/lib$name.a" )
   done
+  ALL_TARGETS+=( "${EMPTY_LIB_TARGETS[@]}" )
+
+  # scalable malloc, linked ahead of libc.a with clang-TARGET -lmalloc-fast
+  local MALLOC_FAST_OBJECTS=()
+  printf "\n# malloc-fast\n" >> $BF
+  for src in src/malloc/fast/*.c; do
+    obj="\$obj/${src}.o"
+    MALLOC_FAST_OBJECTS+=( "$obj" )
+    _cc_rule "$src" "$obj" -fPIC >> $BF
+  done
+  echo "build \$libdir/libmalloc-fast.a: ar ${MALLOC_FAST_OBJECTS[@]}" >> $BF
+  echo "build malloc-fast: phony \$libdir/libmalloc-fast.a" >> $BF
+  ALL_TARGETS+=( "\$libdir/libmalloc-fast.a" )
+
+  # hot core of libc (not built by default)
+  printf "\n# libc core\n" >> $BF
+  echo "build \$libdir/libc-core/libc.a: ar ${LIBC_CORE_OBJECTS[@]} || ${CRT_OBJECTS[@]}" >> $BF
+  echo "build libc-core: phony \$libdir/libc-core/libc.a ${CRT_OBJECTS[@]}" \
+       "${EMPTY_LIB_TARGETS[@]} \$libdir/libmalloc-fast.a" >> $BF
 
   echo >> $BF
   echo "default ${ALL_TARGETS[@]}" >> $BF